@@ -0,0 +1,262 @@
+//
+//  BatchedOscReceiver.cpp
+//  MeltingMe
+//
+
+#include "BatchedOscReceiver.h"
+#include "OscReceivedElements.h"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------
+BatchedOscConfig BatchedOscConfig::fromArgs(int argc, char* argv[]) {
+	BatchedOscConfig config;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--udp-batched") {
+			config.bEnabled = true;
+		}
+		else if (arg == "--udp-rcvbuf" && i + 1 < argc) {
+			config.rcvBufBytes = max(0, ofToInt(argv[++i]));
+		}
+	}
+	return config;
+}
+
+//--------------------------------------------------------------
+string BatchedOscConfig::toString() const {
+	if (!bEnabled) {
+		return "ofxOscReceiver";
+	}
+	return "recvmmsg, SO_RCVBUF " + ofToString(rcvBufBytes);
+}
+
+//--------------------------------------------------------------
+BatchedOscReceiver::~BatchedOscReceiver() {
+	close();
+}
+
+//--------------------------------------------------------------
+bool BatchedOscReceiver::setup(int aport, int abatchSize, int arcvBufBytes, int amaxPacketBytes) {
+	kernelDrops = 0;
+	truncatedPackets = 0;
+	parseErrors = 0;
+	packetsPerSecond = 0;
+	bytesPerSecond = 0;
+
+#ifdef __linux__
+	close();
+
+	socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (socketFd < 0) {
+		ofLogError("BatchedOscReceiver") << "couldn't create socket";
+		return false;
+	}
+
+	setsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, &arcvBufBytes, sizeof(arcvBufBytes));
+	// the kernel doubles the request and caps it at net.core.rmem_max
+	socklen_t optLen = sizeof(rcvBufBytes);
+	getsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, &rcvBufBytes, &optLen);
+
+	int on = 1;
+	setsockopt(socketFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	setsockopt(socketFd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+
+	// wake up regularly so the thread can be stopped
+	timeval timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 100000;
+	setsockopt(socketFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(aport);
+	if (::bind(socketFd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+		ofLogError("BatchedOscReceiver") << "couldn't bind to port " << aport;
+		::close(socketFd);
+		socketFd = -1;
+		return false;
+	}
+
+	batchSize = abatchSize;
+	maxPacketBytes = amaxPacketBytes;
+	packetBuffers.assign(batchSize * maxPacketBytes, 0);
+	controlBuffers.assign(batchSize * CMSG_SPACE(sizeof(uint32_t)), 0);
+
+	ofLogNotice("BatchedOscReceiver") << "listening on " << aport << ", " << batchSize << " packets per call, SO_RCVBUF " << rcvBufBytes;
+	startThread();
+	return true;
+#else
+	return false;
+#endif
+}
+
+//--------------------------------------------------------------
+void BatchedOscReceiver::close() {
+	waitForThread(true);
+#ifdef __linux__
+	if (socketFd >= 0) {
+		::close(socketFd);
+		socketFd = -1;
+	}
+#endif
+}
+
+//--------------------------------------------------------------
+void BatchedOscReceiver::threadedFunction() {
+#ifdef __linux__
+	vector<mmsghdr> msgs(batchSize);
+	vector<iovec> iovecs(batchSize);
+	vector<sockaddr_in> addrs(batchSize);
+	size_t controlSize = CMSG_SPACE(sizeof(uint32_t));
+
+	uint64_t windowStart = ofGetElapsedTimeMillis();
+	uint64_t windowPackets = 0;
+	uint64_t windowBytes = 0;
+
+	while (isThreadRunning()) {
+		for (int i = 0; i < batchSize; i++) {
+			iovecs[i].iov_base = &packetBuffers[i * maxPacketBytes];
+			iovecs[i].iov_len = maxPacketBytes;
+			memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+			msgs[i].msg_hdr.msg_control = &controlBuffers[i * controlSize];
+			msgs[i].msg_hdr.msg_controllen = controlSize;
+		}
+
+		// blocks for the first datagram, then takes whatever else is queued
+		int n = recvmmsg(socketFd, &msgs[0], batchSize, MSG_WAITFORONE, NULL);
+
+		for (int i = 0; i < n; i++) {
+			for (cmsghdr* c = CMSG_FIRSTHDR(&msgs[i].msg_hdr); c != NULL; c = CMSG_NXTHDR(&msgs[i].msg_hdr, c)) {
+				if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL) {
+					uint32_t drops;
+					memcpy(&drops, CMSG_DATA(c), sizeof(drops));
+					kernelDrops = drops;
+				}
+			}
+
+			windowPackets++;
+			windowBytes += msgs[i].msg_len;
+
+			// the rest of the datagram is gone, what's left would parse as a shorter bundle
+			if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+				truncatedPackets++;
+				continue;
+			}
+
+			char ip[INET_ADDRSTRLEN];
+			inet_ntop(AF_INET, &addrs[i].sin_addr, ip, sizeof(ip));
+			processPacket(&packetBuffers[i * maxPacketBytes], msgs[i].msg_len, ip, ntohs(addrs[i].sin_port));
+		}
+
+		uint64_t now = ofGetElapsedTimeMillis();
+		if (now - windowStart >= 1000) {
+			float seconds = (now - windowStart) / 1000.f;
+			packetsPerSecond = windowPackets / seconds;
+			bytesPerSecond = windowBytes / seconds;
+			windowStart = now;
+			windowPackets = 0;
+			windowBytes = 0;
+		}
+	}
+#endif
+}
+
+//--------------------------------------------------------------
+static void appendMessage(const osc::ReceivedMessage& m, const string& aip, int aport, deque<ofxOscMessage>& aout) {
+	aout.push_back(ofxOscMessage());
+	ofxOscMessage& msg = aout.back();
+	msg.setAddress(m.AddressPattern());
+	msg.setRemoteEndpoint(aip, aport);
+	for (osc::ReceivedMessageArgumentIterator arg = m.ArgumentsBegin(); arg != m.ArgumentsEnd(); ++arg) {
+		if (arg->IsInt32()) msg.addIntArg(arg->AsInt32Unchecked());
+		else if (arg->IsInt64()) msg.addInt64Arg(arg->AsInt64Unchecked());
+		else if (arg->IsFloat()) msg.addFloatArg(arg->AsFloatUnchecked());
+		else if (arg->IsDouble()) msg.addDoubleArg(arg->AsDoubleUnchecked());
+		else if (arg->IsString()) msg.addStringArg(arg->AsStringUnchecked());
+		else if (arg->IsSymbol()) msg.addSymbolArg(arg->AsSymbolUnchecked());
+		else if (arg->IsBool()) msg.addBoolArg(arg->AsBoolUnchecked());
+	}
+}
+
+//--------------------------------------------------------------
+static void appendBundle(const osc::ReceivedBundle& b, const string& aip, int aport, deque<ofxOscMessage>& aout) {
+	for (osc::ReceivedBundleElementIterator e = b.ElementsBegin(); e != b.ElementsEnd(); ++e) {
+		if (e->IsBundle()) appendBundle(osc::ReceivedBundle(*e), aip, aport, aout);
+		else appendMessage(osc::ReceivedMessage(*e), aip, aport, aout);
+	}
+}
+
+//--------------------------------------------------------------
+void BatchedOscReceiver::processPacket(const char* adata, int asize, const string& aip, int aport) {
+	// decode outside the lock, the simulation only waits for the splice
+	decoded.clear();
+	try {
+		osc::ReceivedPacket p(adata, asize);
+		if (p.IsBundle()) appendBundle(osc::ReceivedBundle(p), aip, aport, decoded);
+		else appendMessage(osc::ReceivedMessage(p), aip, aport, decoded);
+	}
+	catch (osc::Exception&) {
+		parseErrors++;
+		return;
+	}
+
+	std::unique_lock<std::mutex> qlock(queueMutex);
+	std::move(decoded.begin(), decoded.end(), std::back_inserter(queue));
+}
+
+//--------------------------------------------------------------
+bool BatchedOscReceiver::hasWaitingMessages() {
+	std::unique_lock<std::mutex> qlock(queueMutex);
+	return !queue.empty();
+}
+
+//--------------------------------------------------------------
+bool BatchedOscReceiver::getNextMessage(ofxOscMessage& amsg) {
+	std::unique_lock<std::mutex> qlock(queueMutex);
+	if (queue.empty()) return false;
+	amsg = queue.front();
+	queue.pop_front();
+	return true;
+}
+
+//--------------------------------------------------------------
+float BatchedOscReceiver::getPacketsPerSecond() const {
+	return packetsPerSecond.load();
+}
+
+//--------------------------------------------------------------
+float BatchedOscReceiver::getBytesPerSecond() const {
+	return bytesPerSecond.load();
+}
+
+//--------------------------------------------------------------
+uint64_t BatchedOscReceiver::getKernelDrops() const {
+	return kernelDrops.load();
+}
+
+//--------------------------------------------------------------
+uint64_t BatchedOscReceiver::getTruncatedPackets() const {
+	return truncatedPackets.load();
+}
+
+//--------------------------------------------------------------
+uint64_t BatchedOscReceiver::getParseErrors() const {
+	return parseErrors.load();
+}
+
+//--------------------------------------------------------------
+int BatchedOscReceiver::getRcvBufBytes() const {
+	return rcvBufBytes;
+}
@@ -0,0 +1,71 @@
+//
+//  BatchedOscReceiver.h
+//  MeltingMe
+//
+//  Linux replacement for ofxOscReceiver that pulls a batch of datagrams per
+//  recvmmsg call and counts what the kernel dropped. setup() returns false
+//  on other platforms so the caller can fall back to ofxOscReceiver.
+//
+//  It is only used when asked for on the command line:
+//    --udp-batched                 receive live OSC with recvmmsg
+//    --udp-rcvbuf 4194304          SO_RCVBUF in bytes, capped by net.core.rmem_max
+//
+
+#pragma once
+#include "ofMain.h"
+#include "ofxOsc.h"
+
+class BatchedOscConfig {
+public:
+	bool bEnabled = false;
+	int rcvBufBytes = 4 * 1024 * 1024;
+
+	static BatchedOscConfig fromArgs(int argc, char* argv[]);
+	string toString() const;
+};
+
+class BatchedOscReceiver : public ofThread {
+public:
+	~BatchedOscReceiver();
+
+	// abatchSize datagrams of up to amaxPacketBytes are received per syscall
+	// into buffers allocated here, arcvBufBytes sets SO_RCVBUF
+	bool setup(int aport, int abatchSize = 64, int arcvBufBytes = 4 * 1024 * 1024, int amaxPacketBytes = 1536);
+	void close();
+
+	// same use as ofxOscReceiver
+	bool hasWaitingMessages();
+	bool getNextMessage(ofxOscMessage& amsg);
+
+	// rates over the last full second
+	float getPacketsPerSecond() const;
+	float getBytesPerSecond() const;
+	// datagrams dropped by the kernel since setup, from SO_RXQ_OVFL
+	uint64_t getKernelDrops() const;
+	// datagrams longer than amaxPacketBytes, dropped rather than parsed cut short
+	uint64_t getTruncatedPackets() const;
+	uint64_t getParseErrors() const;
+	int getRcvBufBytes() const;
+
+protected:
+	void threadedFunction();
+	void processPacket(const char* adata, int asize, const string& aip, int aport);
+
+	int socketFd = -1;
+	int batchSize = 0;
+	int maxPacketBytes = 0;
+	int rcvBufBytes = 0;
+	vector<char> packetBuffers;
+	vector<char> controlBuffers;
+
+	// messages of the packet being decoded, only touched by the receive thread
+	deque<ofxOscMessage> decoded;
+	std::mutex queueMutex;
+	deque<ofxOscMessage> queue;
+
+	atomic<uint64_t> kernelDrops;
+	atomic<uint64_t> truncatedPackets;
+	atomic<uint64_t> parseErrors;
+	atomic<float> packetsPerSecond;
+	atomic<float> bytesPerSecond;
+};
@@ -0,0 +1,63 @@
+//
+//  DripEmitter.cpp
+//  MeltingMe
+//
+
+#include "DripEmitter.h"
+
+//--------------------------------------------------------------
+void DripEmitter::emit(vector<Pixel>& apixels, vector<Drip>& adrips, float dt, unsigned int aframe, const GridKernels::Kernels& akernels) {
+	// allow a quarter second of budget to build up for bursts
+	float maxTokens = budgetPerSecond * 0.25f;
+	if (tokens < 0) tokens = maxTokens;
+	tokens = min(tokens + budgetPerSecond * dt, maxTokens);
+
+	// sized for every pixel firing so the kernel can write without checks
+	candidates.resize(apixels.size());
+	int numCandidates = 0;
+	if (apixels.size()) {
+		// each pixel starts at its own phase so neighbours don't fire together
+		numCandidates = akernels.drip(&apixels[0], apixels.size(), ratePerPixel * dt, &candidates[0]);
+	}
+	// a long frame or a high rate can make a pixel due several drips
+	numRequested = 0;
+	for (int k = 0; k < numCandidates; k++) {
+		numRequested += (int)apixels[candidates[k]].dripPhase;
+	}
+
+	// spread the available budget evenly over the grid instead of
+	// letting the first columns take all of it
+	acceptRatio = 1;
+	if (sharedAcceptRatio >= 0) {
+		acceptRatio = sharedAcceptRatio;
+	}
+	else if (numRequested > 0 && (int)tokens < numRequested) {
+		acceptRatio = (int)tokens / (float)numRequested;
+	}
+
+	if (adrips.capacity() < maxDrips + apixels.size() || adrips.capacity() < adrips.size() + numRequested) {
+		adrips.reserve(max(maxDrips + apixels.size(), adrips.size() + numRequested));
+	}
+
+	numEmitted = 0;
+	for (int k = 0; k < numCandidates; k++) {
+		Pixel& p = apixels[candidates[k]];
+		// the fraction carries over to the next frame
+		int due = (int)p.dripPhase;
+		p.dripPhase -= due;
+		for (int d = 0; d < due; d++) {
+			// decided by the cell rather than by its place in the grid, so a
+			// shard picks the same drips as the whole wall would
+			if (acceptRatio < 1 && p.getCellRandom(aframe, Pixel::RANDOM_DRIP + d) >= acceptRatio) continue;
+			adrips.push_back(p.createDrip(p.color));
+			numEmitted++;
+		}
+	}
+	tokens -= numEmitted;
+
+	// drips fade at the same rate, so the oldest ones are also the faintest
+	numShed = sharedAcceptRatio >= 0 ? 0 : max(0, (int)adrips.size() - maxDrips);
+	for (int i = 0; i < numShed; i++) {
+		adrips[i].bRemove = true;
+	}
+}
@@ -0,0 +1,42 @@
+//
+//  DripEmitter.h
+//  MeltingMe
+//
+//  Spawns drips from melting pixels at a fixed rate per pixel, within a
+//  global per-second budget and a cap on live drips.
+//
+
+#pragma once
+#include "ofMain.h"
+#include "Pixel.h"
+#include "GridKernels.h"
+
+class DripEmitter {
+public:
+	// emits from the melting pixels into adrips and marks the oldest drips
+	// beyond maxDrips for removal
+	// aframe picks each cell's draws, see Pixel::getCellRandom()
+	void emit(vector<Pixel>& apixels, vector<Drip>& adrips, float dt, unsigned int aframe, const GridKernels::Kernels& akernels);
+
+	// drips per second from each melting pixel, 30 matches the old 60 fps look
+	float ratePerPixel = 30;
+	// drips per second over the whole grid
+	float budgetPerSecond = 30000;
+	int maxDrips = 25000;
+	// a render node takes the share of requested drips the ingest node's
+	// budget allowed over the whole wall instead of spending a budget of its
+	// own, and leaves the cap to the ingest node, so both sides of a seam
+	// emit and keep the same drips; negative to use the budget
+	float sharedAcceptRatio = -1;
+
+	// counts from the last call
+	int numRequested = 0;
+	int numEmitted = 0;
+	int numShed = 0;
+	// the share of requested drips that was emitted, sent on to render nodes
+	float acceptRatio = 1;
+
+protected:
+	vector<int> candidates;
+	float tokens = -1;
+};
@@ -0,0 +1,239 @@
+//
+//  DualRun.cpp
+//  MeltingMe
+//
+
+#include "DualRun.h"
+
+//--------------------------------------------------------------
+void DualRun::begin(const vector<Pixel>& apixels, const map< string, shared_ptr<Skeleton> >& askeletons) {
+	pixels = apixels;
+	skeletons.clear();
+	for (auto it = askeletons.begin(); it != askeletons.end(); it++) {
+		skeletons[it->first] = it->second->clone();
+	}
+}
+
+//--------------------------------------------------------------
+void DualRun::runReference(float dt, float abodyWidth, float ameltingSpeedBase, float atouchingThresholdBase) {
+	// same order as ofApp::simulate()
+	updatePixelsReference(pixels, skeletons, abodyWidth);
+	detectTouchingReference(skeletons, dt, ameltingSpeedBase, atouchingThresholdBase);
+	for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
+		it->second->update(dt);
+	}
+}
+
+//--------------------------------------------------------------
+bool DualRun::compare(uint64_t aframe, const vector<Pixel>& apixels, const map< string, shared_ptr<Skeleton> >& askeletons) {
+	numFrames++;
+
+	uint64_t referenceHash = hashPixels(pixels);
+	uint64_t optimizedHash = hashPixels(apixels);
+	string bodies = diffSkeletons(askeletons);
+	if (referenceHash == optimizedHash && pixels.size() == apixels.size() && bodies.empty()) {
+		return true;
+	}
+
+	numDivergentFrames++;
+	if (firstDivergentFrame >= 0) {
+		return false;
+	}
+	firstDivergentFrame = aframe;
+
+	ofLogError("DualRun") << "frame " << aframe << " diverges from the reference, grid hash "
+		<< ofToHex(referenceHash) << " != " << ofToHex(optimizedHash);
+	if (pixels.size() != apixels.size()) {
+		ofLogError("DualRun") << "grid sizes differ: " << pixels.size() << " != " << apixels.size();
+	}
+	int numCells = 0;
+	for (int i = 0; i < pixels.size() && i < apixels.size(); i++) {
+		if (isSameCell(pixels[i], apixels[i])) continue;
+		if (numCells < maxReportedCells) {
+			ofLogError("DualRun") << "cell " << i << " at " << pixels[i].rect.x << ", " << pixels[i].rect.y
+				<< " reference " << describeCell(pixels[i]) << " optimized " << describeCell(apixels[i]);
+		}
+		numCells++;
+	}
+	if (numCells) {
+		ofLogError("DualRun") << numCells << " cells differ";
+	}
+	if (!bodies.empty()) {
+		ofLogError("DualRun") << bodies;
+	}
+	return false;
+}
+
+//--------------------------------------------------------------
+void DualRun::updatePixelsReference(vector<Pixel>& apixels, map< string, shared_ptr<Skeleton> >& askeletons, float abodyWidth) {
+	for (int i = 0; i<apixels.size(); i++) {
+		apixels[i].isLitUp = false;
+		apixels[i].isMelting = false;
+		apixels[i].isRestoring = false;
+		apixels[i].preScale = 0;
+	}
+
+	for (auto it = askeletons.begin(); it != askeletons.end(); it++) {
+		for (auto line = it->second->sections.begin(); line != it->second->sections.end(); line++) {
+			float sectionWidth = 0.05f * it->second->scale * pow(line->second.percentLeft, 1 / 4.f) * abodyWidth;
+			if (line->first == "Spine") sectionWidth *= 2;
+			if (line->second.percentLeft < 0.95f) {
+				for (int i = 0; i < apixels.size(); i++) {
+					if (it->second->scale >= apixels[i].preScale && line->second.meltedPoint.distance(apixels[i].rect.getCenter())<sectionWidth) {
+						apixels[i].color = it->second->getColor();
+						apixels[i].preScale = it->second->scale;
+						if (it->second->restoring)
+							apixels[i].isRestoring = true;
+						else {
+							if (!((line->first == "LeftLeg" || line->first == "RightLeg" || line->first == "RightArm" || line->first == "LeftArm") && line->second.percentLeft <= 0.05f))
+								apixels[i].isMelting = true;
+						}
+					}
+				}
+			}
+			for (int i = 0; i < apixels.size(); i++) {
+				if (it->second->scale >= apixels[i].preScale && line->second.line.getClosestPoint(apixels[i].rect.getCenter()).distance(apixels[i].rect.getCenter()) < sectionWidth) {
+					apixels[i].color = it->second->getColor();
+					apixels[i].isRestoring = false;
+					apixels[i].isMelting = false;
+					apixels[i].isLitUp = true;
+					apixels[i].a = ofMap(it->second->scale, 400, 200, 255, 180);
+					apixels[i].preScale = it->second->scale;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i<apixels.size(); i++) {
+		apixels[i].update();
+		if (apixels[i].isRestoring) {
+			apixels[i].a = 255;
+			apixels[i].color = apixels[i].color.lerp(ofColor(255), 0.5f);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+void DualRun::detectTouchingReference(map< string, shared_ptr<Skeleton> >& askeletons, float dt, float ameltingSpeedBase, float atouchingThresholdBase) {
+	for (auto it = askeletons.begin(); it != askeletons.end(); it++) {
+		it->second->restoring = false;
+		it->second->meltingSpeed = dt * ameltingSpeedBase;
+		it->second->hasSameColor = false;
+		for (auto jt = askeletons.begin(); jt != askeletons.end(); jt++) {
+			if (it != jt && it->second->color == jt->second->color) {
+				it->second->hasSameColor = true;
+			}
+		}
+	}
+
+	for (auto it = askeletons.begin(); it != askeletons.end(); it++) {
+		float touchingThreshold = it->second->scale / atouchingThresholdBase;
+		for (auto jt = askeletons.begin(); jt != askeletons.end(); jt++) {
+			if (it != jt) {
+				if (it->second->getJoint("HandLeft")->pos.distance(jt->second->getJoint("HandLeft")->pos) < touchingThreshold
+					|| it->second->getJoint("HandRight")->pos.distance(jt->second->getJoint("HandRight")->pos) < touchingThreshold
+					|| it->second->getJoint("HandLeft")->pos.distance(jt->second->getJoint("HandRight")->pos) < touchingThreshold
+					|| it->second->getJoint("HandRight")->pos.distance(jt->second->getJoint("HandLeft")->pos) < touchingThreshold) {
+					if (it->second->color == jt->second->color) {
+						it->second->restoring = true;
+						jt->second->restoring = true;
+					}
+					else {
+						it->second->meltingSpeed = dt * ameltingSpeedBase * 4;
+						jt->second->meltingSpeed = dt * ameltingSpeedBase * 4;
+					}
+				}
+			}
+		}
+		if (it->second->getJoint("HandRight")->pos.distance(it->second->getJoint("HandLeft")->pos) < touchingThreshold) {
+			if (it->second->hasSameColor)
+				it->second->meltingSpeed = dt * ameltingSpeedBase * 4;
+			else
+				it->second->restoring = true;
+		}
+	}
+}
+
+//--------------------------------------------------------------
+uint64_t DualRun::hashPixels(const vector<Pixel>& apixels) {
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](uint64_t avalue, int abytes) {
+		for (int b = 0; b < abytes; b++) {
+			hash ^= (avalue >> (b * 8)) & 0xff;
+			hash *= 1099511628211ull;
+		}
+	};
+	for (int i = 0; i < apixels.size(); i++) {
+		const Pixel& p = apixels[i];
+		mix(p.isLitUp | (p.isMelting << 1) | (p.isRestoring << 2), 1);
+		mix((uint32_t)p.a, 4);
+		mix(p.color.r | (p.color.g << 8) | (p.color.b << 16), 3);
+	}
+	return hash;
+}
+
+//--------------------------------------------------------------
+uint64_t DualRun::getNumFrames() const {
+	return numFrames;
+}
+
+//--------------------------------------------------------------
+uint64_t DualRun::getNumDivergentFrames() const {
+	return numDivergentFrames;
+}
+
+//--------------------------------------------------------------
+int64_t DualRun::getFirstDivergentFrame() const {
+	return firstDivergentFrame;
+}
+
+//--------------------------------------------------------------
+string DualRun::getSummary() const {
+	string s = "validated " + ofToString(numFrames) + " frames, " + ofToString(numDivergentFrames) + " diverged";
+	if (firstDivergentFrame >= 0) {
+		s += ", first at frame " + ofToString(firstDivergentFrame);
+	}
+	return s;
+}
+
+//--------------------------------------------------------------
+bool DualRun::isSameCell(const Pixel& a, const Pixel& b) {
+	return a.isLitUp == b.isLitUp && a.isMelting == b.isMelting && a.isRestoring == b.isRestoring
+		&& a.a == b.a && a.color.r == b.color.r && a.color.g == b.color.g && a.color.b == b.color.b;
+}
+
+//--------------------------------------------------------------
+string DualRun::describeCell(const Pixel& p) {
+	string flags = string(p.isLitUp ? "L" : "-") + (p.isMelting ? "M" : "-") + (p.isRestoring ? "R" : "-");
+	return flags + " a " + ofToString(p.a) + " rgb " + ofToString((int)p.color.r) + "," + ofToString((int)p.color.g) + "," + ofToString((int)p.color.b);
+}
+
+//--------------------------------------------------------------
+string DualRun::diffSkeletons(const map< string, shared_ptr<Skeleton> >& askeletons) const {
+	string s = "";
+	for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
+		auto other = askeletons.find(it->first);
+		if (other == askeletons.end()) {
+			s += "body " + it->first + " is missing; ";
+			continue;
+		}
+		const Skeleton& reference = *it->second;
+		const Skeleton& optimized = *other->second;
+		if (reference.restoring != optimized.restoring || reference.hasSameColor != optimized.hasSameColor || reference.meltingSpeed != optimized.meltingSpeed) {
+			s += "body " + it->first + " touch state differs: restoring " + ofToString(reference.restoring) + "/" + ofToString(optimized.restoring)
+				+ " same color " + ofToString(reference.hasSameColor) + "/" + ofToString(optimized.hasSameColor)
+				+ " melting speed " + ofToString(reference.meltingSpeed) + "/" + ofToString(optimized.meltingSpeed) + "; ";
+		}
+		for (auto section = reference.sections.begin(); section != reference.sections.end(); section++) {
+			auto otherSection = optimized.sections.find(section->first);
+			if (otherSection == optimized.sections.end() || section->second.percentLeft != otherSection->second.percentLeft
+				|| section->second.meltedPoint != otherSection->second.meltedPoint) {
+				s += "body " + it->first + " " + section->first + " melt differs; ";
+			}
+		}
+	}
+	if (skeletons.size() != askeletons.size()) {
+		s += "body counts differ: " + ofToString(skeletons.size()) + " != " + ofToString(askeletons.size()) + "; ";
+	}
+	return s;
+}
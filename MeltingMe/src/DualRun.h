@@ -0,0 +1,56 @@
+//
+//  DualRun.h
+//  MeltingMe
+//
+//  Validation mode for the optimized grid, touch and melt paths. Each frame
+//  the state they start from is copied, the copy is stepped with the
+//  original (reference) implementations, and both results are hashed over
+//  the cell flags, alpha and color and the body sections. The first frame
+//  where they differ is logged with the cells that differ. The copy is
+//  taken again every frame, so one divergence doesn't carry into the next.
+//
+
+#pragma once
+#include "ofMain.h"
+#include "Pixel.h"
+#include "Skeleton.h"
+
+class DualRun {
+public:
+	// copies the grid and bodies as they are before updatePixels()
+	void begin(const vector<Pixel>& apixels, const map< string, shared_ptr<Skeleton> >& askeletons);
+	// steps the copy with the reference implementations
+	void runReference(float dt, float abodyWidth, float ameltingSpeedBase, float atouchingThresholdBase);
+	// returns false when the optimized step came out different from the copy
+	bool compare(uint64_t aframe, const vector<Pixel>& apixels, const map< string, shared_ptr<Skeleton> >& askeletons);
+
+	// the original per pixel ofPolyline version of ofApp::updatePixels(), without
+	// the drips; SectionKernel matches it exactly, edge cells included
+	static void updatePixelsReference(vector<Pixel>& apixels, map< string, shared_ptr<Skeleton> >& askeletons, float abodyWidth);
+	// the original ofApp::detectTouching(), looking up the hands by name
+	static void detectTouchingReference(map< string, shared_ptr<Skeleton> >& askeletons, float dt, float ameltingSpeedBase, float atouchingThresholdBase);
+	// FNV-1a over the flags, alpha and color of every cell
+	static uint64_t hashPixels(const vector<Pixel>& apixels);
+
+	uint64_t getNumFrames() const;
+	uint64_t getNumDivergentFrames() const;
+	// -1 until a frame diverges
+	int64_t getFirstDivergentFrame() const;
+	string getSummary() const;
+
+	// how many differing cells the first divergence lists
+	int maxReportedCells = 20;
+
+protected:
+	static bool isSameCell(const Pixel& a, const Pixel& b);
+	static string describeCell(const Pixel& p);
+	// the bodies whose melt state differs, empty if none
+	string diffSkeletons(const map< string, shared_ptr<Skeleton> >& askeletons) const;
+
+	vector<Pixel> pixels;
+	map< string, shared_ptr<Skeleton> > skeletons;
+	// read by the gui while the pipeline thread compares
+	atomic<uint64_t> numFrames{ 0 };
+	atomic<uint64_t> numDivergentFrames{ 0 };
+	atomic<int64_t> firstDivergentFrame{ -1 };
+};
@@ -0,0 +1,139 @@
+//
+//  Energy.cpp
+//  MeltingMe
+//
+
+#include "Energy.h"
+
+//--------------------------------------------------------------
+void EnergyPool::setup(int acapacity) {
+	capacity = acapacity;
+	x.assign(capacity, 0);
+	y.assign(capacity, 0);
+	vx.assign(capacity, 0);
+	vy.assign(capacity, 0);
+	age.assign(capacity, 0);
+	fade.assign(capacity, 1);
+	count = 0;
+
+	mesh.clear();
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+	mesh.getVertices().reserve(capacity * 6);
+	mesh.getColors().reserve(capacity * 6);
+}
+
+//--------------------------------------------------------------
+bool EnergyPool::spawn(const ofVec2f& apos) {
+	if (count >= capacity) {
+		numDropped++;
+		return false;
+	}
+	x[count] = apos.x;
+	y[count] = apos.y;
+	vx[count] = 0;
+	vy[count] = 0;
+	age[count] = 0;
+	fade[count] = 1;
+	count++;
+	return true;
+}
+
+//--------------------------------------------------------------
+void EnergyPool::update(float dt, const vector<ofVec2f>& atargets) {
+	float drag = max(0.f, 1.f - damping * dt);
+	float absorb2 = absorbRadius * absorbRadius;
+
+	for (int i = 0; i < count; i++) {
+		age[i] += dt;
+
+		if (atargets.empty()) {
+			fade[i] -= dt / fadeTime;
+			if (fade[i] <= 0) {
+				remove(i--);
+				continue;
+			}
+		}
+		else {
+			float bestD2 = numeric_limits<float>::max();
+			float dx = 0, dy = 0;
+			for (int k = 0; k < atargets.size(); k++) {
+				float tx = atargets[k].x - x[i];
+				float ty = atargets[k].y - y[i];
+				float d2 = tx * tx + ty * ty;
+				if (d2 < bestD2) {
+					bestD2 = d2;
+					dx = tx;
+					dy = ty;
+				}
+			}
+			if (bestD2 < absorb2) {
+				remove(i--);
+				continue;
+			}
+			float invD = 1.f / sqrt(bestD2);
+			vx[i] = (vx[i] + dx * invD * accel * dt) * drag;
+			vy[i] = (vy[i] + dy * invD * accel * dt) * drag;
+		}
+
+		x[i] += vx[i] * dt;
+		y[i] += vy[i] * dt;
+	}
+}
+
+//--------------------------------------------------------------
+void EnergyPool::remove(int i) {
+	// swap the last live particle into the hole to keep the arrays packed
+	count--;
+	x[i] = x[count];
+	y[i] = y[count];
+	vx[i] = vx[count];
+	vy[i] = vy[count];
+	age[i] = age[count];
+	fade[i] = fade[count];
+}
+
+//--------------------------------------------------------------
+void EnergyPool::buildMesh() {
+	mesh.clear();
+	float h = particleSize * 0.5f;
+	for (int i = 0; i < count; i++) {
+		// fade in over the first tenth of a second like a spark igniting
+		ofColor c = color;
+		c.a = 255 * min(1.f, age[i] * 10) * fade[i];
+
+		ofVec3f tl(x[i] - h, y[i] - h), tr(x[i] + h, y[i] - h);
+		ofVec3f bl(x[i] - h, y[i] + h), br(x[i] + h, y[i] + h);
+		mesh.addVertex(tl);
+		mesh.addVertex(tr);
+		mesh.addVertex(br);
+		mesh.addVertex(tl);
+		mesh.addVertex(br);
+		mesh.addVertex(bl);
+		for (int k = 0; k < 6; k++) {
+			mesh.addColor(c);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+void EnergyPool::draw() const {
+	if (mesh.getNumVertices()) {
+		mesh.draw();
+	}
+}
+
+//--------------------------------------------------------------
+int EnergyPool::size() const {
+	return count;
+}
+
+//--------------------------------------------------------------
+int EnergyPool::getCapacity() const {
+	return capacity;
+}
+
+//--------------------------------------------------------------
+void EnergyPool::clear() {
+	count = 0;
+	mesh.clear();
+}
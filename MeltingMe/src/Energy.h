@@ -0,0 +1,46 @@
+//
+//  Energy.h
+//  MeltingMe
+//
+//  Fixed capacity pool of the particles that flow from restoring pixels
+//  into the hands that are touching.
+//
+
+#pragma once
+#include "ofMain.h"
+
+class EnergyPool {
+public:
+	void setup(int acapacity);
+
+	// returns false when the pool is full
+	bool spawn(const ofVec2f& apos);
+	// homes every particle toward its nearest target, particles reaching a
+	// target are absorbed, without targets they fade out
+	void update(float dt, const vector<ofVec2f>& atargets);
+	// rebuilds mesh from the live particles
+	void buildMesh();
+	void draw() const;
+
+	int size() const;
+	int getCapacity() const;
+	void clear();
+
+	float accel = 2400;
+	float damping = 4;
+	float particleSize = 6;
+	float absorbRadius = 12;
+	float fadeTime = 0.5f;
+	ofColor color = ofColor(255, 245, 0);
+
+	// every live particle as quads, drawn in one call
+	ofMesh mesh;
+	int numDropped = 0;
+
+protected:
+	void remove(int i);
+
+	vector<float> x, y, vx, vy, age, fade;
+	int count = 0;
+	int capacity = 0;
+};
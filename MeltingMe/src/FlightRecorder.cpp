@@ -0,0 +1,165 @@
+//
+//  FlightRecorder.cpp
+//  MeltingMe
+//
+
+#include "FlightRecorder.h"
+
+//--------------------------------------------------------------
+FlightRecorder::~FlightRecorder() {
+	waitForThread(false);
+}
+
+//--------------------------------------------------------------
+void FlightRecorder::setup(float awindowSeconds, int asamplesPerSecond) {
+	windowSeconds = awindowSeconds;
+	samples.assign(max(1, (int)(awindowSeconds * asamplesPerSecond)), Sample());
+	writeCount = 0;
+}
+
+//--------------------------------------------------------------
+void FlightRecorder::record(float atime, const string& abodyId, Skeleton::JointIndex ajoint, float ax, float ay, float az, const string& astate) {
+	if (samples.empty() || ajoint == Skeleton::TOTAL_JOINTS) return;
+
+	uint64_t index = writeCount.load(memory_order_relaxed);
+	// the count published by the last call must be visible before this
+	// slot starts changing, the reader relies on it to spot torn samples
+	atomic_thread_fence(memory_order_release);
+	Sample& s = samples[index % samples.size()];
+	s.bodyId = parseBodyId(abodyId);
+	s.time = atime;
+	s.x = ax;
+	s.y = ay;
+	s.z = az;
+	s.joint = ajoint;
+	s.state = parseState(astate);
+	writeCount.store(index + 1, memory_order_release);
+}
+
+//--------------------------------------------------------------
+bool FlightRecorder::dump() {
+	if (isThreadRunning()) {
+		ofLogWarning("FlightRecorder") << "still writing " << dumpFilename;
+		return false;
+	}
+	// the join is immediate, the last dump already finished
+	waitForThread(false);
+	dumpEnd = writeCount.load(memory_order_acquire);
+	dumpFilename = "recordings/" + ofGetTimestampString() + "-flight.txt";
+	startThread();
+	return true;
+}
+
+//--------------------------------------------------------------
+void FlightRecorder::threadedFunction() {
+	uint64_t capacity = samples.size();
+	// record() may already be writing the slot of sample dumpEnd, which is
+	// the oldest one still in the ring
+	uint64_t begin = dumpEnd + 1 > capacity ? dumpEnd + 1 - capacity : 0;
+
+	// copy in chunks; whatever the live writer overwrote while we copied
+	// is dropped from the front once the chunk has been read
+	const uint64_t chunkSize = 4096;
+	vector<Sample> chunk;
+	chunk.reserve(chunkSize);
+	ofBuffer buffer;
+	float startTime = -1;
+	float endTime = dumpEnd > 0 ? samples[(dumpEnd - 1) % capacity].time : 0;
+	int numWritten = 0;
+
+	for (uint64_t c = begin; c < dumpEnd; c += chunkSize) {
+		uint64_t cend = min(c + chunkSize, dumpEnd);
+		chunk.clear();
+		for (uint64_t i = c; i < cend; i++) {
+			chunk.push_back(samples[i % capacity]);
+		}
+		// keeps the copy above from moving past the count load, like a seqlock;
+		// the slot record() is in the middle of writing counts as overwritten too
+		atomic_thread_fence(memory_order_acquire);
+		uint64_t overwritten = writeCount.load(memory_order_relaxed) + 1;
+		overwritten = overwritten > capacity ? overwritten - capacity : 0;
+
+		for (uint64_t i = c; i < cend; i++) {
+			if (i < overwritten) continue;
+			const Sample& s = chunk[i - c];
+			if (endTime - s.time > windowSeconds) continue;
+			if (startTime < 0) startTime = s.time;
+
+			buffer.append(ofToString(s.time - startTime) + "|");
+			buffer.append("/bodies/" + ofToString(s.bodyId) + "/joints/" + Skeleton::getNameForIndex((Skeleton::JointIndex)s.joint));
+			buffer.append("|f" + ofToString(s.x, 6));
+			buffer.append("|f" + ofToString(s.y, 6));
+			buffer.append("|f" + ofToString(s.z, 6));
+			buffer.append("|s" + getStateName((TrackingState)s.state));
+			buffer.append("\n");
+			numWritten++;
+		}
+	}
+
+	if (!ofDirectory::doesDirectoryExist("recordings/")) {
+		ofDirectory::createDirectory("recordings/");
+	}
+	ofBufferToFile(dumpFilename, buffer);
+	ofLogNotice("FlightRecorder") << "wrote " << numWritten << " samples to " << dumpFilename;
+}
+
+//--------------------------------------------------------------
+bool FlightRecorder::isDumping() const {
+	return isThreadRunning();
+}
+
+//--------------------------------------------------------------
+float FlightRecorder::getWindowSeconds() const {
+	return windowSeconds;
+}
+
+//--------------------------------------------------------------
+int FlightRecorder::getCapacity() const {
+	return samples.size();
+}
+
+//--------------------------------------------------------------
+uint64_t FlightRecorder::getNumRecorded() const {
+	return writeCount.load();
+}
+
+//--------------------------------------------------------------
+uint64_t FlightRecorder::parseBodyId(const string& abodyId) {
+	// Kinect tracking ids are numbers, anything else gets an FNV-1a hash
+	uint64_t value = 0;
+	bool bNumeric = !abodyId.empty() && abodyId.size() < 20;
+	for (int i = 0; i < abodyId.size() && bNumeric; i++) {
+		if (abodyId[i] < '0' || abodyId[i] > '9') bNumeric = false;
+		else value = value * 10 + (abodyId[i] - '0');
+	}
+	if (bNumeric) return value;
+
+	uint64_t hash = 14695981039346656037ULL;
+	for (int i = 0; i < abodyId.size(); i++) {
+		hash = (hash ^ (uint8_t)abodyId[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+//--------------------------------------------------------------
+FlightRecorder::TrackingState FlightRecorder::parseState(const string& astate) {
+	if (astate == "Tracked") return TRACKED;
+	if (astate == "Inferred") return INFERRED;
+	if (astate == "NotTracked") return NOT_TRACKED;
+	return UNKNOWN;
+}
+
+//--------------------------------------------------------------
+string FlightRecorder::getStateName(TrackingState astate) {
+	switch (astate) {
+	case TRACKED:
+		return "Tracked";
+	case INFERRED:
+		return "Inferred";
+	case NOT_TRACKED:
+		return "NotTracked";
+	default:
+		break;
+	}
+	return "Unknown";
+}
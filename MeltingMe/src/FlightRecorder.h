@@ -0,0 +1,62 @@
+//
+//  FlightRecorder.h
+//  MeltingMe
+//
+//  Always-on ring buffer of the last few minutes of live joint samples,
+//  dumped to recordings/ on demand from a background thread.
+//
+
+#pragma once
+#include "ofMain.h"
+#include "Skeleton.h"
+
+class FlightRecorder : public ofThread {
+public:
+	enum TrackingState {
+		TRACKED = 0,
+		INFERRED,
+		NOT_TRACKED,
+		UNKNOWN
+	};
+
+	class Sample {
+	public:
+		uint64_t bodyId = 0;
+		float time = 0;
+		float x = 0, y = 0, z = 0;
+		uint8_t joint = 0;
+		uint8_t state = UNKNOWN;
+	};
+
+	~FlightRecorder();
+
+	// memory is allocated once here, awindowSeconds * asamplesPerSecond samples;
+	// the default is 30 fps * 25 joints * 2 bodies, a crowd shortens the window
+	void setup(float awindowSeconds, int asamplesPerSecond = 1500);
+
+	// called for every live joint message, never allocates
+	void record(float atime, const string& abodyId, Skeleton::JointIndex ajoint, float ax, float ay, float az, const string& astate);
+
+	// writes the window to recordings/ without blocking the caller,
+	// returns false if a dump is still in progress
+	bool dump();
+
+	bool isDumping() const;
+	float getWindowSeconds() const;
+	int getCapacity() const;
+	uint64_t getNumRecorded() const;
+
+	static uint64_t parseBodyId(const string& abodyId);
+	static TrackingState parseState(const string& astate);
+	static string getStateName(TrackingState astate);
+
+protected:
+	void threadedFunction();
+
+	vector<Sample> samples;
+	float windowSeconds = 600;
+	// total samples ever written, the ring index is writeCount % capacity
+	atomic<uint64_t> writeCount;
+	uint64_t dumpEnd = 0;
+	string dumpFilename;
+};
@@ -0,0 +1,113 @@
+//
+//  FramePipeline.cpp
+//  MeltingMe
+//
+
+#include "FramePipeline.h"
+
+//--------------------------------------------------------------
+FramePipeline::FramePipeline() {
+	readyIndex = 0;
+}
+
+//--------------------------------------------------------------
+FramePipeline::~FramePipeline() {
+	stop();
+}
+
+//--------------------------------------------------------------
+void FramePipeline::start(StepFunction astep) {
+	if (isThreadRunning()) return;
+	step = astep;
+	{
+		std::unique_lock<std::mutex> rlock(requestMutex);
+		bStepPending = false;
+		bStopping = false;
+		pendingDt = 0;
+	}
+	startThread();
+}
+
+//--------------------------------------------------------------
+void FramePipeline::stop() {
+	if (!isThreadRunning()) return;
+	{
+		std::unique_lock<std::mutex> rlock(requestMutex);
+		bStopping = true;
+	}
+	requestCondition.notify_one();
+	waitForThread(true);
+}
+
+//--------------------------------------------------------------
+void FramePipeline::requestStep(float atime, float adt, const FrameSettings& asettings) {
+	{
+		std::unique_lock<std::mutex> rlock(requestMutex);
+		pendingTime = atime;
+		pendingDt += adt;
+		pendingSettings = asettings;
+		bStepPending = true;
+	}
+	requestCondition.notify_one();
+}
+
+//--------------------------------------------------------------
+const FrameSnapshot& FramePipeline::acquire() {
+	if (readyIndex.load() & FRESH) {
+		readIndex = readyIndex.exchange(readIndex) & ~FRESH;
+	}
+	return snapshots[readIndex];
+}
+
+//--------------------------------------------------------------
+void FramePipeline::threadedFunction() {
+	while (isThreadRunning()) {
+		float stepTime, stepDt;
+		{
+			std::unique_lock<std::mutex> rlock(requestMutex);
+			while (!bStepPending && !bStopping) {
+				requestCondition.wait(rlock);
+			}
+			if (bStopping) break;
+			stepTime = pendingTime;
+			stepDt = pendingDt;
+			stepSettings = pendingSettings;
+			pendingDt = 0;
+			bStepPending = false;
+		}
+
+		lock();
+		step(stepTime, stepDt, stepSettings, snapshots[writeIndex]);
+		unlock();
+		snapshots[writeIndex].frameNum = ++numSteps;
+
+		// hand the finished snapshot to the render thread, take back the stale one
+		writeIndex = readyIndex.exchange(writeIndex | FRESH) & ~FRESH;
+	}
+}
+
+//--------------------------------------------------------------
+void SkeletonSnapshot::set(Skeleton& askeleton) {
+	// assigning into the old snapshot reuses its storage
+	sections = askeleton.sections;
+	for (int i = 0; i < Skeleton::TOTAL_JOINTS; i++) {
+		shared_ptr<Skeleton::Joint> joint = askeleton.getJoint((Skeleton::JointIndex)i);
+		joints[i] = joint->pos;
+		jointsSeen[i] = joint->bSeen;
+	}
+	color = askeleton.getColor();
+	scale = askeleton.scale;
+	bRestoring = askeleton.restoring;
+}
+
+//--------------------------------------------------------------
+void SkeletonSnapshot::draw() const {
+	// same as Skeleton::draw()
+	/*for(auto& line: sections){
+	line.second.line.draw();
+	}
+
+	for(int i = 0; i < Skeleton::TOTAL_JOINTS; i++) {
+	ofDrawSphere(ofVec2f(joints[i]), 10 );
+	}*/
+}
@@ -0,0 +1,107 @@
+//
+//  FramePipeline.h
+//  MeltingMe
+//
+//  Runs the simulation for frame N+1 on a worker thread while the
+//  render thread draws the snapshot of frame N.
+//
+
+#pragma once
+#include "ofMain.h"
+#include "Pixel.h"
+#include "Skeleton.h"
+
+// The gui values a frame is simulated with, copied on the main thread so
+// the worker never reads an ofParameter while the gui writes it.
+class FrameSettings {
+public:
+	bool bRecording = false;
+	bool bUseRecordedData = false;
+	bool bValidate = false;
+	bool bBlockCoverage = true;
+	bool bBreakOnAlloc = false;
+	float numRows = 120;
+	float numCols = 90;
+	float bodyWidth = 1;
+	float meltingSpeedBase = 0.1f;
+	float touchingThresholdBase = 10;
+	float dropSpeed = 0.8f;
+	float dripRate = 30;
+	int dripBudget = 30000;
+	int maxDrips = 25000;
+	float energyRate = 2;
+	float imageScale = 1;
+	int offsetX = 0;
+	int offsetY = 0;
+};
+
+// One body as draw() sees it, copied out of the Skeleton the worker keeps melting.
+class SkeletonSnapshot {
+public:
+	void set(Skeleton& askeleton);
+	void draw() const;
+
+	map<string, Skeleton::BodySection> sections;
+	ofVec3f joints[Skeleton::TOTAL_JOINTS];
+	bool jointsSeen[Skeleton::TOTAL_JOINTS] = {};
+	ofColor color;
+	float scale = 0;
+	bool bRestoring = false;
+};
+
+// Everything draw() needs from one simulated frame.
+class FrameSnapshot {
+public:
+	vector<Pixel> pixels;
+	vector<Drip> drips;
+	vector<SkeletonSnapshot> skeletons;
+	ofMesh energyMesh;
+	int numEnergies = 0;
+	float energyMillis = 0;
+	int numExactCells = 0;
+	uint64_t frameNum = 0;
+};
+
+class FramePipeline : public ofThread {
+public:
+	// astep simulates one frame of length adt ending at atime with asettings and fills the snapshot
+	typedef function<void(float atime, float adt, const FrameSettings& asettings, FrameSnapshot& asnapshot)> StepFunction;
+
+	FramePipeline();
+	~FramePipeline();
+
+	void start(StepFunction astep);
+	void stop();
+
+	// called once per frame from update(); requests that arrive while a step
+	// is still running are merged so no simulated time is lost, and the
+	// newest settings win
+	void requestStep(float atime, float adt, const FrameSettings& asettings);
+
+	// swaps in the newest finished snapshot, if there is one, and returns
+	// the snapshot the render thread should draw
+	const FrameSnapshot& acquire();
+
+protected:
+	void threadedFunction();
+
+	static const int FRESH = 4;
+
+	StepFunction step;
+	FrameSnapshot snapshots[3];
+	// the index of the last finished snapshot, with FRESH set until the render thread takes it
+	atomic<int> readyIndex;
+	int writeIndex = 1;
+	int readIndex = 2;
+	uint64_t numSteps = 0;
+
+	std::mutex requestMutex;
+	condition_variable requestCondition;
+	bool bStepPending = false;
+	bool bStopping = false;
+	float pendingTime = 0;
+	float pendingDt = 0;
+	FrameSettings pendingSettings;
+	// the worker's copy of pendingSettings for the step it is running
+	FrameSettings stepSettings;
+};
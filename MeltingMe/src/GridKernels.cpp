@@ -0,0 +1,172 @@
+//
+//  GridKernels.cpp
+//  MeltingMe
+//
+
+#include "GridKernels.h"
+
+namespace GridKernels {
+
+	// COUNT is 0 in the generic kernels, which use acount instead
+
+	//--------------------------------------------------------------
+	template<int COUNT> static void resetPixels(Pixel* apixels, int acount) {
+		const int n = COUNT ? COUNT : acount;
+		for (int i = 0; i < n; i++) {
+			apixels[i].isLitUp = false;
+			apixels[i].isMelting = false;
+			apixels[i].isRestoring = false;
+			apixels[i].preScale = 0;
+		}
+	}
+
+	//--------------------------------------------------------------
+	template<int COUNT, SectionType S> static void evaluateSection(Pixel* apixels, const float* acx, const float* acy, int acount, const SectionInput& ain) {
+		const int n = COUNT ? COUNT : acount;
+		const float scale = ain.scale;
+
+		if (ain.percentLeft < 0.95f) {
+			const bool bMelts = !(SectionTraits<S>::bMeltExempt && ain.percentLeft <= 0.05f);
+			for (int i = 0; i < n; i++) {
+				Pixel& p = apixels[i];
+				if (scale >= p.preScale && ain.meltedPoint.distance(ofVec3f(acx[i], acy[i], 0)) < ain.width) {
+					p.color = ain.color;
+					p.preScale = scale;
+					if (ain.bRestoring)
+						p.isRestoring = true;
+					else if (bMelts)
+						p.isMelting = true;
+				}
+			}
+		}
+
+		const unsigned char* inside = ain.inside;
+		for (int i = 0; i < n; i++) {
+			Pixel& p = apixels[i];
+			if (scale >= p.preScale && inside[i]) {
+				p.color = ain.color;
+				p.isRestoring = false;
+				p.isMelting = false;
+				p.isLitUp = true;
+				p.a = ain.alpha;
+				p.preScale = scale;
+			}
+		}
+	}
+
+	//--------------------------------------------------------------
+	template<int COUNT> static void decayPixels(Pixel* apixels, int acount) {
+		const int n = COUNT ? COUNT : acount;
+		for (int i = 0; i < n; i++) {
+			// same as Pixel::update()
+			int a = apixels[i].a - 50;
+			apixels[i].a = a < 0 ? 0 : a;
+		}
+	}
+
+	//--------------------------------------------------------------
+	template<int COUNT> static void restorePixels(Pixel* apixels, int acount) {
+		const int n = COUNT ? COUNT : acount;
+		for (int i = 0; i < n; i++) {
+			if (apixels[i].isRestoring) {
+				apixels[i].a = 255;
+				apixels[i].color = apixels[i].color.lerp(ofColor(255), 0.5f);
+			}
+		}
+	}
+
+	//--------------------------------------------------------------
+	template<int COUNT> static int advanceDrips(Pixel* apixels, int acount, float aphaseStep, int* acandidates) {
+		const int n = COUNT ? COUNT : acount;
+		int numCandidates = 0;
+		for (int i = 0; i < n; i++) {
+			Pixel& p = apixels[i];
+			if (!p.isMelting) continue;
+			p.dripPhase += aphaseStep;
+			// the whole drips come off the phase in DripEmitter
+			if (p.dripPhase >= 1) {
+				acandidates[numCandidates++] = i;
+			}
+		}
+		return numCandidates;
+	}
+
+	//--------------------------------------------------------------
+	template<int COLUMNS, int ROWS> static Kernels makeKernels() {
+		const int COUNT = COLUMNS * ROWS;
+		Kernels k;
+		k.columns = COLUMNS;
+		k.rows = ROWS;
+		k.name = COUNT ? ofToString(COLUMNS) + "x" + ofToString(ROWS) : "generic";
+		k.reset = resetPixels<COUNT>;
+		k.sections[LEFT_LEG] = evaluateSection<COUNT, LEFT_LEG>;
+		k.sections[RIGHT_LEG] = evaluateSection<COUNT, RIGHT_LEG>;
+		k.sections[LEFT_ARM] = evaluateSection<COUNT, LEFT_ARM>;
+		k.sections[RIGHT_ARM] = evaluateSection<COUNT, RIGHT_ARM>;
+		k.sections[SPINE] = evaluateSection<COUNT, SPINE>;
+		k.decay = decayPixels<COUNT>;
+		k.restore = restorePixels<COUNT>;
+		k.drip = advanceDrips<COUNT>;
+		return k;
+	}
+
+	// the generic kernels first, then the grid sizes the installations use
+	static const Kernels kernelTable[] = {
+		makeKernels<0, 0>(),
+		makeKernels<120, 90>(),
+		makeKernels<160, 120>(),
+		makeKernels<240, 180>()
+	};
+
+	static const string sectionNames[TOTAL_SECTIONS + 1] = {
+		"LeftLeg",
+		"RightLeg",
+		"LeftArm",
+		"RightArm",
+		"Spine",
+		"Unknown"
+	};
+
+	//--------------------------------------------------------------
+	const string& getSectionName(SectionType atype) {
+		return sectionNames[atype < TOTAL_SECTIONS ? atype : TOTAL_SECTIONS];
+	}
+
+	//--------------------------------------------------------------
+	SectionType getSectionType(const string& aname) {
+		for (int i = 0; i < TOTAL_SECTIONS; i++) {
+			if (sectionNames[i] == aname) return (SectionType)i;
+		}
+		return TOTAL_SECTIONS;
+	}
+
+	//--------------------------------------------------------------
+	float getWidthMultiplier(SectionType atype) {
+		switch (atype) {
+		case LEFT_LEG:
+			return SectionTraits<LEFT_LEG>::widthMultiplier;
+		case RIGHT_LEG:
+			return SectionTraits<RIGHT_LEG>::widthMultiplier;
+		case LEFT_ARM:
+			return SectionTraits<LEFT_ARM>::widthMultiplier;
+		case RIGHT_ARM:
+			return SectionTraits<RIGHT_ARM>::widthMultiplier;
+		case SPINE:
+			return SectionTraits<SPINE>::widthMultiplier;
+		default:
+			break;
+		}
+		return 1;
+	}
+
+	//--------------------------------------------------------------
+	const Kernels& getKernels(int acolumns, int arows, int acount) {
+		for (int i = 1; i < sizeof(kernelTable) / sizeof(kernelTable[0]); i++) {
+			const Kernels& k = kernelTable[i];
+			if (k.columns == acolumns && k.rows == arows && acount == k.columns * k.rows) {
+				return k;
+			}
+		}
+		return kernelTable[0];
+	}
+}
@@ -0,0 +1,83 @@
+//
+//  GridKernels.h
+//  MeltingMe
+//
+//  The per-pixel loops of updatePixels() and DripEmitter, compiled once for
+//  each standard grid size and body section so the loop counts and section
+//  rules are constants, plus a generic version for every other grid.
+//
+
+#pragma once
+#include "ofMain.h"
+#include "Pixel.h"
+
+namespace GridKernels {
+
+	enum SectionType {
+		LEFT_LEG = 0,
+		RIGHT_LEG,
+		LEFT_ARM,
+		RIGHT_ARM,
+		SPINE,
+		TOTAL_SECTIONS
+	};
+
+	template<SectionType S> class SectionTraits {
+	public:
+		static constexpr float widthMultiplier = 1;
+		// limbs that have nearly melted away stop melting the pixels under them
+		static constexpr bool bMeltExempt = true;
+	};
+
+	template<> class SectionTraits<SPINE> {
+	public:
+		static constexpr float widthMultiplier = 2;
+		static constexpr bool bMeltExempt = false;
+	};
+
+	// what one section of one body contributes to the grid this frame
+	class SectionInput {
+	public:
+		ofVec3f meltedPoint;
+		float percentLeft = 1;
+		// already multiplied by the section's widthMultiplier
+		float width = 0;
+		float scale = 0;
+		ofColor color;
+		int alpha = 255;
+		bool bRestoring = false;
+		// from SectionKernel::classify
+		const unsigned char* inside = NULL;
+	};
+
+	typedef void(*PixelFunction)(Pixel* apixels, int acount);
+	typedef void(*SectionFunction)(Pixel* apixels, const float* acx, const float* acy, int acount, const SectionInput& ain);
+	// advances the drip phase of melting pixels, writes the ones due at
+	// least one drip to acandidates and returns how many there are
+	typedef int(*DripFunction)(Pixel* apixels, int acount, float aphaseStep, int* acandidates);
+
+	class Kernels {
+	public:
+		// 0 for the generic kernels
+		int columns = 0;
+		int rows = 0;
+		string name = "";
+		// clears the flags and preScale of every pixel
+		PixelFunction reset = NULL;
+		SectionFunction sections[TOTAL_SECTIONS];
+		// fades every pixel
+		PixelFunction decay = NULL;
+		// brightens the restoring pixels
+		PixelFunction restore = NULL;
+		DripFunction drip = NULL;
+	};
+
+	// the names Skeleton keys its sections by
+	const string& getSectionName(SectionType atype);
+	SectionType getSectionType(const string& aname);
+	float getWidthMultiplier(SectionType atype);
+
+	// the kernels compiled for acolumns x arows, or the generic ones when
+	// there are none or the grid holds only part of the cells (a shard)
+	const Kernels& getKernels(int acolumns, int arows, int acount);
+}
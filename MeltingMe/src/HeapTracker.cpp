@@ -0,0 +1,132 @@
+//
+//  HeapTracker.cpp
+//  MeltingMe
+//
+
+#include "HeapTracker.h"
+#include <cstdlib>
+#include <csignal>
+#include <new>
+
+namespace HeapTracker {
+
+	// plain thread locals, safe to touch before and after any constructor runs
+	static thread_local uint64_t threadAllocations = 0;
+	static thread_local uint64_t threadBytes = 0;
+	static thread_local bool bNoAlloc = false;
+
+	static atomic<uint64_t> violations{ 0 };
+	static atomic<bool> bBreakOnViolation{ false };
+
+	//--------------------------------------------------------------
+	static inline void track(size_t asize) {
+		threadAllocations++;
+		threadBytes += asize;
+		if (bNoAlloc) {
+			violations.fetch_add(1, memory_order_relaxed);
+#ifdef _DEBUG
+			if (bBreakOnViolation.load(memory_order_relaxed)) {
+				// an assert report allocates, which would come back in here, so
+				// the scope is off while the debugger has the thread
+				bNoAlloc = false;
+				// look up the call stack for what allocated
+#ifdef _MSC_VER
+				__debugbreak();
+#else
+				raise(SIGTRAP);
+#endif
+				bNoAlloc = true;
+			}
+#endif
+		}
+	}
+
+	//--------------------------------------------------------------
+	static inline void* allocate(size_t asize) {
+		track(asize);
+		void* p = malloc(asize ? asize : 1);
+		if (!p) throw std::bad_alloc();
+		return p;
+	}
+
+	//--------------------------------------------------------------
+	Counts getThreadCounts() {
+		Counts c;
+		c.allocations = threadAllocations;
+		c.bytes = threadBytes;
+		return c;
+	}
+
+	//--------------------------------------------------------------
+	uint64_t getViolations() {
+		return violations.load(memory_order_relaxed);
+	}
+
+	//--------------------------------------------------------------
+	void setBreakOnViolation(bool abreak) {
+		bBreakOnViolation = abreak;
+	}
+
+	//--------------------------------------------------------------
+	NoAllocScope::NoAllocScope(bool aenabled) {
+		bWasActive = bNoAlloc;
+		if (aenabled) bNoAlloc = true;
+	}
+
+	//--------------------------------------------------------------
+	NoAllocScope::~NoAllocScope() {
+		bNoAlloc = bWasActive;
+	}
+}
+
+//--------------------------------------------------------------
+void* operator new(size_t asize) {
+	return HeapTracker::allocate(asize);
+}
+
+//--------------------------------------------------------------
+void* operator new[](size_t asize) {
+	return HeapTracker::allocate(asize);
+}
+
+//--------------------------------------------------------------
+void* operator new(size_t asize, const std::nothrow_t&) noexcept {
+	HeapTracker::track(asize);
+	return malloc(asize ? asize : 1);
+}
+
+//--------------------------------------------------------------
+void* operator new[](size_t asize, const std::nothrow_t&) noexcept {
+	HeapTracker::track(asize);
+	return malloc(asize ? asize : 1);
+}
+
+//--------------------------------------------------------------
+void operator delete(void* aptr) noexcept {
+	free(aptr);
+}
+
+//--------------------------------------------------------------
+void operator delete[](void* aptr) noexcept {
+	free(aptr);
+}
+
+//--------------------------------------------------------------
+void operator delete(void* aptr, size_t) noexcept {
+	free(aptr);
+}
+
+//--------------------------------------------------------------
+void operator delete[](void* aptr, size_t) noexcept {
+	free(aptr);
+}
+
+//--------------------------------------------------------------
+void operator delete(void* aptr, const std::nothrow_t&) noexcept {
+	free(aptr);
+}
+
+//--------------------------------------------------------------
+void operator delete[](void* aptr, const std::nothrow_t&) noexcept {
+	free(aptr);
+}
@@ -0,0 +1,43 @@
+//
+//  HeapTracker.h
+//  MeltingMe
+//
+//  Counts heap allocations per thread by replacing the global operator new,
+//  so Metrics can report allocations per frame and per stage. Everything the
+//  app and the standard containers allocate goes through operator new;
+//  plain malloc() from C libraries isn't seen.
+//
+//  A NoAllocScope marks code that must not allocate once the scene has
+//  warmed up. Allocations inside one are counted as violations, and with
+//  setBreakOnViolation(true) a debug build breaks into the debugger at
+//  the allocating call.
+//
+
+#pragma once
+#include "ofMain.h"
+
+namespace HeapTracker {
+
+	class Counts {
+	public:
+		uint64_t allocations = 0;
+		uint64_t bytes = 0;
+	};
+
+	// everything the calling thread has allocated so far
+	Counts getThreadCounts();
+
+	// allocations made inside a NoAllocScope, on any thread
+	uint64_t getViolations();
+	void setBreakOnViolation(bool abreak);
+
+	class NoAllocScope {
+	public:
+		// a disabled scope does nothing, for scopes that only apply sometimes
+		NoAllocScope(bool aenabled = true);
+		~NoAllocScope();
+
+	protected:
+		bool bWasActive = false;
+	};
+}
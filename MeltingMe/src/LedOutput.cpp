@@ -0,0 +1,370 @@
+//
+//  LedOutput.cpp
+//  MeltingMe
+//
+
+#include "LedOutput.h"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+//--------------------------------------------------------------
+LedOutput::~LedOutput() {
+	close();
+}
+
+//--------------------------------------------------------------
+bool LedOutput::setup(const string& amapPath) {
+	close();
+	readyIndex = 0;
+	framesSent = 0;
+	framesSkipped = 0;
+	for (int i = 0; i < 256; i++) packMicros[i] = 0;
+
+	if (!loadMap(amapPath)) {
+		return false;
+	}
+
+#ifdef __linux__
+	socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (socketFd < 0) {
+		ofLogError("LedOutput") << "couldn't create socket";
+		return false;
+	}
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 || connect(socketFd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+		ofLogError("LedOutput") << "couldn't connect to " << host << ":" << port;
+		::close(socketFd);
+		socketFd = -1;
+		return false;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		frames[i].assign(universes.size() * PACKET_BYTES, 0);
+		writeHeaders(frames[i]);
+	}
+
+	ofLogNotice("LedOutput") << fixtures.size() << " fixtures in " << universes.size() << " universes to " << host << ":" << port;
+	startThread();
+	return true;
+#else
+	ofLogWarning("LedOutput") << "sendmmsg isn't available, LED output is off";
+	return false;
+#endif
+}
+
+//--------------------------------------------------------------
+void LedOutput::close() {
+	if (isThreadRunning()) {
+		stopThread();
+		wakeCondition.notify_one();
+		waitForThread(false);
+	}
+#ifdef __linux__
+	if (socketFd >= 0) {
+		::close(socketFd);
+		socketFd = -1;
+	}
+#endif
+}
+
+//--------------------------------------------------------------
+bool LedOutput::loadMap(const string& amapPath) {
+	fixtures.clear();
+	universes.clear();
+
+	if (!ofFile::doesFileExist(amapPath)) {
+		return false;
+	}
+
+	ofBuffer buffer = ofBufferFromFile(amapPath);
+	for (auto line : buffer.getLines()) {
+		vector<string> parts = ofSplitString(line, " ", true, true);
+		if (parts.empty() || parts[0][0] == '#') continue;
+
+		if (parts[0] == "target" && parts.size() >= 2) {
+			host = parts[1];
+			if (parts.size() >= 3) port = ofToInt(parts[2]);
+		}
+		else if (parts[0] == "block" && parts.size() >= 6) {
+			int x0 = ofToInt(parts[1]), y0 = ofToInt(parts[2]);
+			int w = ofToInt(parts[3]), h = ofToInt(parts[4]);
+			int universe = ofToInt(parts[5]);
+			int n = 0;
+			for (int y = y0; y < y0 + h; y++) {
+				for (int x = x0; x < x0 + w; x++) {
+					Fixture f;
+					f.x = x;
+					f.y = y;
+					f.universe = universe + n / FIXTURES_PER_UNIVERSE;
+					f.channel = (n % FIXTURES_PER_UNIVERSE) * 3;
+					fixtures.push_back(f);
+					n++;
+				}
+			}
+		}
+		else if (parts.size() >= 4) {
+			Fixture f;
+			f.x = ofToInt(parts[0]);
+			f.y = ofToInt(parts[1]);
+			f.universe = ofToInt(parts[2]);
+			f.channel = ofToInt(parts[3]) - 1;
+			if (f.channel < 0 || f.channel + 3 > CHANNELS) {
+				ofLogWarning("LedOutput") << "channel out of range: " << line;
+				continue;
+			}
+			fixtures.push_back(f);
+		}
+	}
+
+	if (host == "" || fixtures.empty()) {
+		ofLogWarning("LedOutput") << amapPath << " needs a target and at least one fixture";
+		return false;
+	}
+
+	for (int i = 0; i < fixtures.size(); i++) {
+		universes.push_back(fixtures[i].universe);
+	}
+	sort(universes.begin(), universes.end());
+	universes.erase(unique(universes.begin(), universes.end()), universes.end());
+
+	fixtureOffsets.resize(fixtures.size());
+	for (int i = 0; i < fixtures.size(); i++) {
+		int packet = lower_bound(universes.begin(), universes.end(), fixtures[i].universe) - universes.begin();
+		fixtureOffsets[i] = packet * PACKET_BYTES + HEADER_BYTES + fixtures[i].channel;
+	}
+	fixtureCells.assign(fixtures.size(), -1);
+	return true;
+}
+
+//--------------------------------------------------------------
+void LedOutput::writeHeaders(vector<char>& aframe) {
+	// ArtDmx, everything but the sequence number stays the same
+	for (int i = 0; i < universes.size(); i++) {
+		char* p = &aframe[i * PACKET_BYTES];
+		memcpy(p, "Art-Net", 8);
+		p[8] = 0x00;
+		p[9] = 0x50;
+		p[10] = 0;
+		p[11] = 14;
+		p[12] = 0;
+		p[13] = 0;
+		p[14] = universes[i] & 0xff;
+		p[15] = (universes[i] >> 8) & 0x7f;
+		p[16] = CHANNELS >> 8;
+		p[17] = CHANNELS & 0xff;
+	}
+}
+
+//--------------------------------------------------------------
+void LedOutput::resolve(function<int(int ax, int ay)> aindexOf) {
+	for (int i = 0; i < fixtures.size(); i++) {
+		fixtureCells[i] = aindexOf(fixtures[i].x, fixtures[i].y);
+	}
+}
+
+//--------------------------------------------------------------
+void LedOutput::pack(const vector<Pixel>& apixels) {
+	if (!isThreadRunning()) return;
+
+	char* frame = &frames[writeIndex][0];
+	for (int i = 0; i < fixtureCells.size(); i++) {
+		int cell = fixtureCells[i];
+		unsigned char* dst = (unsigned char*)frame + fixtureOffsets[i];
+		if (cell < 0 || cell >= apixels.size()) {
+			dst[0] = dst[1] = dst[2] = 0;
+			continue;
+		}
+		const Pixel& p = apixels[cell];
+		int a = ofClamp(p.a, 0, 255);
+		dst[0] = p.color.r * a / 255;
+		dst[1] = p.color.g * a / 255;
+		dst[2] = p.color.b * a / 255;
+	}
+
+	// 0 means the receiver shouldn't check the order, so it's skipped
+	sequence = sequence % 255 + 1;
+	for (int i = 0; i < universes.size(); i++) {
+		frame[i * PACKET_BYTES + 12] = sequence;
+	}
+	packMicros[sequence] = ofGetElapsedTimeMicros();
+
+	int previous = readyIndex.exchange(writeIndex | FRESH);
+	if (previous & FRESH) framesSkipped++;
+	writeIndex = previous & ~FRESH;
+	wakeCondition.notify_one();
+}
+
+//--------------------------------------------------------------
+void LedOutput::threadedFunction() {
+#ifdef __linux__
+	// one set of headers per buffer, built once so sending never allocates
+	int numPackets = universes.size();
+	vector<mmsghdr> msgs[3];
+	vector<iovec> iovecs[3];
+	for (int b = 0; b < 3; b++) {
+		msgs[b].resize(numPackets);
+		iovecs[b].resize(numPackets);
+		for (int i = 0; i < numPackets; i++) {
+			iovecs[b][i].iov_base = &frames[b][i * PACKET_BYTES];
+			iovecs[b][i].iov_len = PACKET_BYTES;
+			memset(&msgs[b][i], 0, sizeof(mmsghdr));
+			msgs[b][i].msg_hdr.msg_iov = &iovecs[b][i];
+			msgs[b][i].msg_hdr.msg_iovlen = 1;
+		}
+	}
+
+	while (isThreadRunning()) {
+		{
+			std::unique_lock<std::mutex> wlock(wakeMutex);
+			wakeCondition.wait_for(wlock, chrono::milliseconds(100), [this] {
+				return (readyIndex.load() & FRESH) || !isThreadRunning();
+			});
+		}
+		if (!(readyIndex.load() & FRESH)) continue;
+		sendIndex = readyIndex.exchange(sendIndex) & ~FRESH;
+
+		int sent = 0;
+		while (sent < numPackets) {
+			int n = sendmmsg(socketFd, &msgs[sendIndex][sent], numPackets - sent, 0);
+			if (n <= 0) {
+				if (errno == EINTR) continue;
+				// nobody listening yet shows up as ECONNREFUSED on a connected socket
+				break;
+			}
+			sent += n;
+		}
+		if (sent == numPackets) framesSent++;
+	}
+#endif
+}
+
+//--------------------------------------------------------------
+LedLoopbackCheck::~LedLoopbackCheck() {
+	close();
+}
+
+//--------------------------------------------------------------
+bool LedLoopbackCheck::setup(const LedOutput& aoutput) {
+	close();
+	completeFrames = 0;
+	incompleteFrames = 0;
+	latencyMillis = 0;
+	maxLatencyMillis = 0;
+
+#ifdef __linux__
+	output = &aoutput;
+	numUniverses = aoutput.getNumUniverses();
+	currentSequence = -1;
+
+	socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (socketFd < 0) return false;
+
+	int rcvBuf = 4 * 1024 * 1024;
+	setsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+	timeval timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 100000;
+	setsockopt(socketFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(aoutput.getPort());
+	if (::bind(socketFd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+		ofLogError("LedLoopbackCheck") << "couldn't bind to port " << aoutput.getPort();
+		::close(socketFd);
+		socketFd = -1;
+		return false;
+	}
+
+	ofLogNotice("LedLoopbackCheck") << "checking " << numUniverses << " universes per frame on " << aoutput.getPort();
+	startThread();
+	return true;
+#else
+	return false;
+#endif
+}
+
+//--------------------------------------------------------------
+void LedLoopbackCheck::close() {
+	waitForThread(true);
+#ifdef __linux__
+	if (socketFd >= 0) {
+		::close(socketFd);
+		socketFd = -1;
+	}
+#endif
+}
+
+//--------------------------------------------------------------
+void LedLoopbackCheck::finishFrame() {
+	if (currentSequence < 0) return;
+	if (currentPackets == numUniverses) {
+		completeFrames++;
+		uint64_t latency = currentLastMicros - output->getPackMicros(currentSequence);
+		windowFrames++;
+		windowMicros += latency;
+		windowMax = max(windowMax, latency);
+	}
+	else {
+		incompleteFrames++;
+	}
+}
+
+//--------------------------------------------------------------
+void LedLoopbackCheck::threadedFunction() {
+#ifdef __linux__
+	const int batchSize = 64;
+	vector<char> buffers(batchSize * LedOutput::PACKET_BYTES);
+	vector<mmsghdr> msgs(batchSize);
+	vector<iovec> iovecs(batchSize);
+	windowStart = ofGetElapsedTimeMillis();
+
+	while (isThreadRunning()) {
+		for (int i = 0; i < batchSize; i++) {
+			iovecs[i].iov_base = &buffers[i * LedOutput::PACKET_BYTES];
+			iovecs[i].iov_len = LedOutput::PACKET_BYTES;
+			memset(&msgs[i], 0, sizeof(mmsghdr));
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int n = recvmmsg(socketFd, &msgs[0], batchSize, MSG_WAITFORONE, NULL);
+		uint64_t now = ofGetElapsedTimeMicros();
+
+		for (int i = 0; i < n; i++) {
+			const char* p = &buffers[i * LedOutput::PACKET_BYTES];
+			if (msgs[i].msg_len != LedOutput::PACKET_BYTES || memcmp(p, "Art-Net", 8) != 0) continue;
+			int sequence = (unsigned char)p[12];
+			// packets of a frame go out back to back, a new sequence closes the last frame
+			if (sequence != currentSequence) {
+				finishFrame();
+				currentSequence = sequence;
+				currentPackets = 0;
+			}
+			currentPackets++;
+			currentLastMicros = now;
+		}
+
+		uint64_t nowMillis = ofGetElapsedTimeMillis();
+		if (nowMillis - windowStart >= 1000) {
+			latencyMillis = windowFrames ? windowMicros / 1000.f / windowFrames : 0;
+			maxLatencyMillis = windowMax / 1000.f;
+			windowStart = nowMillis;
+			windowFrames = 0;
+			windowMicros = 0;
+			windowMax = 0;
+		}
+	}
+#endif
+}
@@ -0,0 +1,128 @@
+//
+//  LedOutput.h
+//  MeltingMe
+//
+//  Sends the pixel grid to LED controllers as Art-Net DMX packets, one
+//  per universe, from a dedicated thread with sendmmsg. Linux only,
+//  setup() returns false elsewhere.
+//
+//  The mapping table (bin/data/led-map.txt) looks like:
+//    target 10.0.0.20 6454
+//    # one RGB fixture: cell x, cell y, universe, first DMX channel (1-512)
+//    0 0 0 1
+//    # a block of cells, row by row, 170 fixtures per universe from the given one
+//    block 0 0 120 90 0
+//
+
+#pragma once
+#include "ofMain.h"
+#include "Pixel.h"
+
+class LedOutput : public ofThread {
+public:
+	class Fixture {
+	public:
+		int x = 0, y = 0;
+		int universe = 0;
+		// 0 based offset of the red channel
+		int channel = 0;
+	};
+
+	static const int CHANNELS = 512;
+	static const int HEADER_BYTES = 18;
+	static const int PACKET_BYTES = HEADER_BYTES + CHANNELS;
+	static const int FIXTURES_PER_UNIVERSE = CHANNELS / 3;
+
+	~LedOutput();
+
+	// reads the mapping table and allocates every send buffer, returns false
+	// if there is no table or no sendmmsg
+	bool setup(const string& amapPath);
+	void close();
+
+	// points each fixture at its index in the pixel vector, call whenever the
+	// grid is rebuilt; aindexOf returns -1 for cells that aren't there
+	void resolve(function<int(int ax, int ay)> aindexOf);
+
+	// writes color * alpha of the mapped cells straight into the next set of
+	// packets and hands it to the output thread, never allocates
+	void pack(const vector<Pixel>& apixels);
+
+	const string& getHost() const { return host; }
+	int getPort() const { return port; }
+	int getNumUniverses() const { return universes.size(); }
+	int getNumFixtures() const { return fixtures.size(); }
+	uint64_t getFramesSent() const { return framesSent; }
+	// packed frames replaced by a newer one before the thread got to them
+	uint64_t getFramesSkipped() const { return framesSkipped; }
+	// when the frame with this Art-Net sequence number was packed
+	uint64_t getPackMicros(uint8_t asequence) const { return packMicros[asequence]; }
+
+protected:
+	void threadedFunction();
+	bool loadMap(const string& amapPath);
+	void writeHeaders(vector<char>& aframe);
+
+	static const int FRESH = 4;
+
+	string host = "";
+	int port = 6454;
+	int socketFd = -1;
+
+	vector<Fixture> fixtures;
+	// index into the pixels and into the frame buffer for every fixture, -1 if unmapped
+	vector<int> fixtureCells;
+	vector<int> fixtureOffsets;
+	// sorted universe numbers, packet i of a frame carries universes[i]
+	vector<int> universes;
+
+	// triple buffered like FramePipeline: pack() fills one, the thread sends another
+	vector<char> frames[3];
+	atomic<int> readyIndex;
+	int writeIndex = 1;
+	int sendIndex = 2;
+	uint8_t sequence = 0;
+
+	std::mutex wakeMutex;
+	condition_variable wakeCondition;
+
+	atomic<uint64_t> framesSent;
+	atomic<uint64_t> framesSkipped;
+	atomic<uint64_t> packMicros[256];
+};
+
+// Listens where LedOutput sends on this host and checks every frame
+// arrives whole, and how long after pack() it does.
+class LedLoopbackCheck : public ofThread {
+public:
+	~LedLoopbackCheck();
+
+	bool setup(const LedOutput& aoutput);
+	void close();
+
+	uint64_t getCompleteFrames() const { return completeFrames; }
+	uint64_t getIncompleteFrames() const { return incompleteFrames; }
+	// pack() to last packet of the frame, averaged over the last second
+	float getLatencyMillis() const { return latencyMillis; }
+	float getMaxLatencyMillis() const { return maxLatencyMillis; }
+
+protected:
+	void threadedFunction();
+	void finishFrame();
+
+	const LedOutput* output = NULL;
+	int socketFd = -1;
+	int numUniverses = 0;
+	int currentSequence = -1;
+	int currentPackets = 0;
+	uint64_t currentLastMicros = 0;
+
+	atomic<uint64_t> completeFrames;
+	atomic<uint64_t> incompleteFrames;
+	atomic<float> latencyMillis;
+	atomic<float> maxLatencyMillis;
+	uint64_t windowStart = 0;
+	uint64_t windowFrames = 0;
+	uint64_t windowMicros = 0;
+	uint64_t windowMax = 0;
+};
@@ -0,0 +1,382 @@
+//
+//  Metrics.cpp
+//  MeltingMe
+//
+
+#include "Metrics.h"
+#include <iomanip>
+
+#ifdef TARGET_WIN32
+#include <winsock2.h>
+#include <psapi.h>
+#pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "psapi.lib")
+#define closeSocket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define closeSocket ::close
+#endif
+
+//--------------------------------------------------------------
+Metrics::Metrics() {
+	for (int i = 0; i < FRAME_BUCKETS; i++) frameBuckets[i] = 0;
+	for (int i = 0; i < TOTAL_STAGES; i++) {
+		stageMicros[i] = 0;
+		stageCalls[i] = 0;
+		stageAllocations[i] = 0;
+		stageBytes[i] = 0;
+		lastStageAllocations[i] = 0;
+	}
+	for (int i = 0; i < TOTAL_GAUGES; i++) gauges[i] = 0;
+	for (int i = 0; i < TOTAL_COUNTERS; i++) counters[i] = 0;
+	frameMaxMicros = 0;
+}
+
+//--------------------------------------------------------------
+Metrics::~Metrics() {
+	close();
+}
+
+//--------------------------------------------------------------
+bool Metrics::setup(int aport) {
+	close();
+
+#ifdef TARGET_WIN32
+	WSADATA wsaData;
+	WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+	for (int p = aport; p < aport + 8; p++) {
+		socketFd = socket(AF_INET, SOCK_STREAM, 0);
+		if (socketFd < 0) {
+			ofLogError("Metrics") << "couldn't create socket";
+			return false;
+		}
+
+		// only reachable from this machine, a tunnel or local agent does the scraping
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(p);
+		if (::bind(socketFd, (sockaddr*)&addr, sizeof(addr)) == 0 && listen(socketFd, 4) == 0) {
+			port = p;
+			break;
+		}
+		closeSocket(socketFd);
+		socketFd = -1;
+	}
+	if (socketFd < 0) {
+		ofLogError("Metrics") << "no free port in " << aport << "-" << aport + 7;
+		return false;
+	}
+
+	history.assign(HISTORY, Sample());
+	numSamples = 0;
+	startMillis = ofGetElapsedTimeMillis();
+	takeSample();
+
+	ofLogNotice("Metrics") << "serving http://127.0.0.1:" << port << "/metrics";
+	startThread();
+	return true;
+}
+
+//--------------------------------------------------------------
+void Metrics::close() {
+	waitForThread(true);
+	if (socketFd >= 0) {
+		closeSocket(socketFd);
+		socketFd = -1;
+	}
+}
+
+//--------------------------------------------------------------
+void Metrics::recordFrame(float adt) {
+	uint64_t micros = adt > 0 ? (uint64_t)(adt * 1000000) : 0;
+	int bucket = min((int)(adt * 1000 / FRAME_BUCKET_MS), FRAME_BUCKETS - 1);
+	frameBuckets[max(0, bucket)].fetch_add(1, memory_order_relaxed);
+
+	uint64_t prevMax = frameMaxMicros.load(memory_order_relaxed);
+	while (micros > prevMax && !frameMaxMicros.compare_exchange_weak(prevMax, micros, memory_order_relaxed)) {}
+}
+
+//--------------------------------------------------------------
+Metrics::Mark Metrics::mark() {
+	Mark m;
+	m.micros = ofGetElapsedTimeMicros();
+	m.heap = HeapTracker::getThreadCounts();
+	return m;
+}
+
+//--------------------------------------------------------------
+Metrics::Mark Metrics::endStage(Stage astage, const Mark& astart) {
+	Mark now = mark();
+	uint64_t allocations = now.heap.allocations - astart.heap.allocations;
+	stageMicros[astage].fetch_add(now.micros - astart.micros, memory_order_relaxed);
+	stageCalls[astage].fetch_add(1, memory_order_relaxed);
+	stageAllocations[astage].fetch_add(allocations, memory_order_relaxed);
+	stageBytes[astage].fetch_add(now.heap.bytes - astart.heap.bytes, memory_order_relaxed);
+	lastStageAllocations[astage].store(allocations, memory_order_relaxed);
+	return now;
+}
+
+//--------------------------------------------------------------
+uint64_t Metrics::getLastAllocations(Stage astage) const {
+	return lastStageAllocations[astage].load(memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+void Metrics::setGauge(Gauge agauge, int64_t avalue) {
+	gauges[agauge].store(avalue, memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+void Metrics::count(Counter acounter, uint64_t an) {
+	counters[acounter].fetch_add(an, memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+void Metrics::setCounter(Counter acounter, uint64_t avalue) {
+	counters[acounter].store(avalue, memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+void Metrics::takeSample() {
+	Sample& s = history[numSamples % HISTORY];
+	for (int i = 0; i < FRAME_BUCKETS; i++) s.frameBuckets[i] = frameBuckets[i].load(memory_order_relaxed);
+	for (int i = 0; i < TOTAL_STAGES; i++) {
+		s.stageMicros[i] = stageMicros[i].load(memory_order_relaxed);
+		s.stageCalls[i] = stageCalls[i].load(memory_order_relaxed);
+		s.stageAllocations[i] = stageAllocations[i].load(memory_order_relaxed);
+		s.stageBytes[i] = stageBytes[i].load(memory_order_relaxed);
+	}
+	for (int i = 0; i < TOTAL_COUNTERS; i++) s.counters[i] = counters[i].load(memory_order_relaxed);
+	s.timeMillis = ofGetElapsedTimeMillis();
+	lastFrameMax = frameMaxMicros.exchange(0, memory_order_relaxed);
+	numSamples++;
+}
+
+//--------------------------------------------------------------
+void Metrics::threadedFunction() {
+	while (isThreadRunning()) {
+		// wake up regularly to sample and to notice the thread being stopped
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(socketFd, &readSet);
+		timeval timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 100000;
+		int ready = select((int)socketFd + 1, &readSet, NULL, NULL, &timeout);
+
+		if (ofGetElapsedTimeMillis() - history[(numSamples - 1) % HISTORY].timeMillis >= 1000) {
+			takeSample();
+		}
+
+		if (ready > 0) {
+			intptr_t client = accept(socketFd, NULL, NULL);
+			if (client >= 0) {
+				serveClient(client);
+				closeSocket(client);
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------
+static void setSocketTimeouts(intptr_t asocket, int amillis) {
+#ifdef TARGET_WIN32
+	DWORD timeout = amillis;
+#else
+	timeval timeout;
+	timeout.tv_sec = amillis / 1000;
+	timeout.tv_usec = (amillis % 1000) * 1000;
+#endif
+	setsockopt(asocket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+	setsockopt(asocket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+//--------------------------------------------------------------
+void Metrics::serveClient(intptr_t aclient) {
+	// a client that connects and goes quiet may only hold up sampling this long
+	setSocketTimeouts(aclient, CLIENT_TIMEOUT_MS);
+
+	// every path gets the same page, the request is only read so the client sees a clean close
+	char request[1024];
+	recv(aclient, request, sizeof(request), 0);
+
+	string body = buildPage();
+	string response = "HTTP/1.0 200 OK\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: " + ofToString(body.size()) + "\r\n"
+		"Connection: close\r\n\r\n" + body;
+
+	size_t sent = 0;
+	while (sent < response.size()) {
+		int n = send(aclient, response.data() + sent, (int)(response.size() - sent), 0);
+		if (n <= 0) break;
+		sent += n;
+	}
+}
+
+//--------------------------------------------------------------
+string Metrics::buildPage() {
+	const Sample& newest = history[(numSamples - 1) % HISTORY];
+	const Sample& prev = history[(max(numSamples, 2) - 2) % HISTORY];
+	const Sample& oldest = history[numSamples > HISTORY ? numSamples % HISTORY : 0];
+	float seconds = max(1ull, (unsigned long long)(newest.timeMillis - prev.timeMillis)) / 1000.f;
+
+	stringstream ss;
+	ss << fixed << setprecision(3);
+
+	ss << "# HELP melting_frame_ms frame time over the last " << (HISTORY - 1) << " seconds\n";
+	ss << "# TYPE melting_frame_ms summary\n";
+	uint64_t numFrames = 0;
+	for (int i = 0; i < FRAME_BUCKETS; i++) numFrames += newest.frameBuckets[i] - oldest.frameBuckets[i];
+	const float quantiles[] = { 0.5f, 0.9f, 0.99f };
+	for (float q : quantiles) {
+		// upper edge of the bucket the quantile falls in
+		uint64_t rank = (uint64_t)ceil(q * numFrames);
+		uint64_t seen = 0;
+		float ms = 0;
+		for (int i = 0; i < FRAME_BUCKETS && numFrames; i++) {
+			seen += newest.frameBuckets[i] - oldest.frameBuckets[i];
+			if (seen >= rank) {
+				ms = (i + 1) * FRAME_BUCKET_MS;
+				break;
+			}
+		}
+		ss << "melting_frame_ms{quantile=\"" << ofToString(q) << "\"} " << ms << "\n";
+	}
+	ss << "melting_frame_ms_count " << numFrames << "\n";
+	ss << "# HELP melting_frame_max_ms longest frame of the last second\n";
+	ss << "# TYPE melting_frame_max_ms gauge\n";
+	ss << "melting_frame_max_ms " << lastFrameMax / 1000.f << "\n";
+
+	ss << "# HELP melting_stage_ms average time per call over the last second\n";
+	ss << "# TYPE melting_stage_ms gauge\n";
+	for (int i = 0; i < TOTAL_STAGES; i++) {
+		uint64_t calls = newest.stageCalls[i] - prev.stageCalls[i];
+		float ms = calls ? (newest.stageMicros[i] - prev.stageMicros[i]) / 1000.f / calls : 0;
+		ss << "melting_stage_ms{stage=\"" << getStageName((Stage)i) << "\"} " << ms << "\n";
+	}
+	ss << "# HELP melting_stage_allocations average heap allocations per call over the last second\n";
+	ss << "# TYPE melting_stage_allocations gauge\n";
+	for (int i = 0; i < TOTAL_STAGES; i++) {
+		uint64_t calls = newest.stageCalls[i] - prev.stageCalls[i];
+		float allocations = calls ? (newest.stageAllocations[i] - prev.stageAllocations[i]) / (float)calls : 0;
+		ss << "melting_stage_allocations{stage=\"" << getStageName((Stage)i) << "\"} " << allocations << "\n";
+	}
+	ss << "# HELP melting_stage_allocated_bytes average bytes allocated per call over the last second\n";
+	ss << "# TYPE melting_stage_allocated_bytes gauge\n";
+	for (int i = 0; i < TOTAL_STAGES; i++) {
+		uint64_t calls = newest.stageCalls[i] - prev.stageCalls[i];
+		float bytes = calls ? (newest.stageBytes[i] - prev.stageBytes[i]) / (float)calls : 0;
+		ss << "melting_stage_allocated_bytes{stage=\"" << getStageName((Stage)i) << "\"} " << bytes << "\n";
+	}
+	ss << "# TYPE melting_heap_violations_total counter\n";
+	ss << "melting_heap_violations_total " << HeapTracker::getViolations() << "\n";
+
+	for (int i = 0; i < TOTAL_GAUGES; i++) {
+		ss << "# TYPE melting_" << getGaugeName((Gauge)i) << " gauge\n";
+		ss << "melting_" << getGaugeName((Gauge)i) << " " << gauges[i].load(memory_order_relaxed) << "\n";
+	}
+
+	for (int i = 0; i < TOTAL_COUNTERS; i++) {
+		ss << "# TYPE melting_" << getCounterName((Counter)i) << "_total counter\n";
+		ss << "melting_" << getCounterName((Counter)i) << "_total " << counters[i].load(memory_order_relaxed) << "\n";
+	}
+	ss << "# TYPE melting_osc_messages_per_second gauge\n";
+	ss << "melting_osc_messages_per_second " << (newest.counters[COUNTER_OSC_MESSAGES] - prev.counters[COUNTER_OSC_MESSAGES]) / seconds << "\n";
+
+	ss << "# TYPE melting_memory_bytes gauge\n";
+	ss << "melting_memory_bytes " << getMemoryBytes() << "\n";
+	ss << "# TYPE melting_uptime_seconds gauge\n";
+	ss << "melting_uptime_seconds " << (ofGetElapsedTimeMillis() - startMillis) / 1000 << "\n";
+
+	return ss.str();
+}
+
+//--------------------------------------------------------------
+uint64_t Metrics::getMemoryBytes() {
+#if defined(TARGET_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+		return pmc.WorkingSetSize;
+	}
+#elif defined(__linux__)
+	// the second field is the resident size in pages
+	ifstream statm("/proc/self/statm");
+	uint64_t size = 0, resident = 0;
+	if (statm >> size >> resident) {
+		return resident * sysconf(_SC_PAGESIZE);
+	}
+#endif
+	return 0;
+}
+
+//--------------------------------------------------------------
+string Metrics::getStageName(Stage astage) {
+	switch (astage) {
+	case STAGE_INGEST:
+		return "ingest";
+	case STAGE_PIXELS:
+		return "pixels";
+	case STAGE_DRIPS:
+		return "drips";
+	case STAGE_TOUCHING:
+		return "touching";
+	case STAGE_ENERGIES:
+		return "energies";
+	case STAGE_MELT:
+		return "melt";
+	case STAGE_LED:
+		return "led";
+	case STAGE_SIMULATE:
+		return "simulate";
+	default:
+		break;
+	}
+	return "unknown";
+}
+
+//--------------------------------------------------------------
+string Metrics::getGaugeName(Gauge agauge) {
+	switch (agauge) {
+	case GAUGE_SKELETONS:
+		return "skeletons";
+	case GAUGE_DRIPS:
+		return "drips";
+	case GAUGE_ENERGIES:
+		return "energies";
+	case GAUGE_PIXELS:
+		return "pixels";
+	case GAUGE_EXACT_CELLS:
+		return "exact_cells";
+	default:
+		break;
+	}
+	return "unknown";
+}
+
+//--------------------------------------------------------------
+string Metrics::getCounterName(Counter acounter) {
+	switch (acounter) {
+	case COUNTER_OSC_MESSAGES:
+		return "osc_messages";
+	case COUNTER_PARSE_ERRORS:
+		return "parse_errors";
+	case COUNTER_EVICTIONS:
+		return "stale_body_evictions";
+	case COUNTER_UDP_DROPS:
+		return "udp_drops";
+	case COUNTER_UDP_TRUNCATED:
+		return "udp_truncated";
+	default:
+		break;
+	}
+	return "unknown";
+}
@@ -0,0 +1,129 @@
+//
+//  Metrics.h
+//  MeltingMe
+//
+//  Live counters for monitoring an installation, served as a plain-text
+//  (Prometheus style) page on http://127.0.0.1:<port>/metrics.
+//  The app only bumps atomics; rates, averages and percentiles are worked
+//  out on the server thread.
+//
+
+#pragma once
+#include "ofMain.h"
+#include "HeapTracker.h"
+
+class Metrics : public ofThread {
+public:
+	enum Stage {
+		STAGE_INGEST = 0,
+		STAGE_PIXELS,
+		STAGE_DRIPS,
+		STAGE_TOUCHING,
+		STAGE_ENERGIES,
+		STAGE_MELT,
+		STAGE_LED,
+		STAGE_SIMULATE,
+		TOTAL_STAGES
+	};
+
+	enum Gauge {
+		GAUGE_SKELETONS = 0,
+		GAUGE_DRIPS,
+		GAUGE_ENERGIES,
+		GAUGE_PIXELS,
+		// cells the section test had to check one by one in the last frame
+		GAUGE_EXACT_CELLS,
+		TOTAL_GAUGES
+	};
+
+	enum Counter {
+		COUNTER_OSC_MESSAGES = 0,
+		COUNTER_PARSE_ERRORS,
+		COUNTER_EVICTIONS,
+		COUNTER_UDP_DROPS,
+		COUNTER_UDP_TRUNCATED,
+		TOTAL_COUNTERS
+	};
+
+	// where a stage started, in time and in the calling thread's allocations
+	class Mark {
+	public:
+		uint64_t micros = 0;
+		HeapTracker::Counts heap;
+	};
+
+	Metrics();
+	~Metrics();
+
+	// binds 127.0.0.1:aport, or the next free port of the following few so
+	// several nodes can share a host; returns false if none was free
+	bool setup(int aport = 9180);
+	void close();
+	int getPort() const { return port; }
+
+	// everything below is lock free and safe from any thread
+
+	void recordFrame(float adt);
+	static Mark mark();
+	// adds the time and allocations since astart to the stage and returns
+	// a new mark, so consecutive stages can be chained
+	Mark endStage(Stage astage, const Mark& astart);
+	// allocations of the stage's last call, STAGE_SIMULATE is the whole frame
+	uint64_t getLastAllocations(Stage astage) const;
+	void setGauge(Gauge agauge, int64_t avalue);
+	void count(Counter acounter, uint64_t an = 1);
+	// for counters that are kept as totals somewhere else
+	void setCounter(Counter acounter, uint64_t avalue);
+
+	static string getStageName(Stage astage);
+	static string getGaugeName(Gauge agauge);
+	static string getCounterName(Counter acounter);
+	// resident set size of the process
+	static uint64_t getMemoryBytes();
+
+protected:
+	void threadedFunction();
+	// called once a second, keeps the history rates are worked out from
+	void takeSample();
+	string buildPage();
+	void serveClient(intptr_t aclient);
+
+	// frame times in 0.25ms buckets up to 100ms, the last bucket holds the rest
+	static const int FRAME_BUCKETS = 401;
+	static constexpr float FRAME_BUCKET_MS = 0.25f;
+	// percentiles are over the last HISTORY - 1 seconds
+	static const int HISTORY = 11;
+	// receive and send timeout on a scrape, sampling waits for it
+	static const int CLIENT_TIMEOUT_MS = 250;
+
+	class Sample {
+	public:
+		uint64_t frameBuckets[FRAME_BUCKETS];
+		uint64_t stageMicros[TOTAL_STAGES];
+		uint64_t stageCalls[TOTAL_STAGES];
+		uint64_t stageAllocations[TOTAL_STAGES];
+		uint64_t stageBytes[TOTAL_STAGES];
+		uint64_t counters[TOTAL_COUNTERS];
+		uint64_t timeMillis = 0;
+	};
+
+	atomic<uint64_t> frameBuckets[FRAME_BUCKETS];
+	atomic<uint64_t> frameMaxMicros;
+	atomic<uint64_t> stageMicros[TOTAL_STAGES];
+	atomic<uint64_t> stageCalls[TOTAL_STAGES];
+	atomic<uint64_t> stageAllocations[TOTAL_STAGES];
+	atomic<uint64_t> stageBytes[TOTAL_STAGES];
+	atomic<uint64_t> lastStageAllocations[TOTAL_STAGES];
+	atomic<int64_t> gauges[TOTAL_GAUGES];
+	atomic<uint64_t> counters[TOTAL_COUNTERS];
+
+	// only touched by the server thread
+	vector<Sample> history;
+	int numSamples = 0;
+	uint64_t lastFrameMax = 0;
+
+	// a SOCKET on windows
+	intptr_t socketFd = -1;
+	int port = 0;
+	uint64_t startMillis = 0;
+};
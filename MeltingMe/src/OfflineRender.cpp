@@ -0,0 +1,193 @@
+//
+//  OfflineRender.cpp
+//  MeltingMe
+//
+
+#include "OfflineRender.h"
+
+//--------------------------------------------------------------
+OfflineRenderer::~OfflineRenderer() {
+	close();
+}
+
+//--------------------------------------------------------------
+bool OfflineRenderer::setup(const string& afolder, Format aformat, int awidth, int aheight, int anumThreads) {
+	close();
+	if (awidth <= 0 || aheight <= 0) {
+		return false;
+	}
+	if (!ofDirectory::doesDirectoryExist(afolder) && !ofDirectory::createDirectory(afolder, true, true)) {
+		ofLogError("OfflineRenderer") << "couldn't create " << afolder;
+		return false;
+	}
+
+	folder = afolder;
+	format = aformat;
+	width = awidth;
+	height = aheight;
+	framesWritten = 0;
+
+	int numThreads = anumThreads > 0 ? anumThreads : max(1, (int)std::thread::hardware_concurrency());
+	// two frames per worker keeps every worker busy while the app fills the next one
+	slots.resize(numThreads * 2);
+	for (int i = 0; i < slots.size(); i++) {
+		slots[i].image.allocate(width, height, OF_PIXELS_RGB);
+		freeSlots.push_back(i);
+	}
+	for (int i = 0; i < numThreads; i++) {
+		workers.push_back(std::thread(&OfflineRenderer::work, this));
+	}
+
+	ofLogNotice("OfflineRenderer") << "rendering " << width << "x" << height << (format == FORMAT_RAW ? " raw" : " png")
+		<< " frames to " << folder << " on " << numThreads << " threads";
+	return true;
+}
+
+//--------------------------------------------------------------
+void OfflineRenderer::close() {
+	if (workers.empty()) return;
+	{
+		std::unique_lock<std::mutex> qlock(queueMutex);
+		bStopping = true;
+	}
+	queueCondition.notify_all();
+	for (int i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+	workers.clear();
+	slots.clear();
+	queued.clear();
+	freeSlots.clear();
+	acquiredSlot = -1;
+	bStopping = false;
+	ofLogNotice("OfflineRenderer") << "wrote " << framesWritten << " frames to " << folder;
+}
+
+//--------------------------------------------------------------
+FrameSnapshot& OfflineRenderer::acquire() {
+	std::unique_lock<std::mutex> qlock(queueMutex);
+	freeCondition.wait(qlock, [this] { return !freeSlots.empty(); });
+	acquiredSlot = freeSlots.front();
+	freeSlots.pop_front();
+	return slots[acquiredSlot].snapshot;
+}
+
+//--------------------------------------------------------------
+void OfflineRenderer::submit() {
+	{
+		std::unique_lock<std::mutex> qlock(queueMutex);
+		if (acquiredSlot < 0) return;
+		queued.push_back(acquiredSlot);
+		acquiredSlot = -1;
+	}
+	queueCondition.notify_one();
+}
+
+//--------------------------------------------------------------
+uint64_t OfflineRenderer::getFramesWritten() const {
+	return framesWritten;
+}
+
+//--------------------------------------------------------------
+int OfflineRenderer::getNumThreads() const {
+	return workers.size();
+}
+
+//--------------------------------------------------------------
+OfflineRenderer::Format OfflineRenderer::getFormatForName(const string& aname) {
+	return aname == "raw" ? FORMAT_RAW : FORMAT_PNG;
+}
+
+//--------------------------------------------------------------
+void OfflineRenderer::work() {
+	while (true) {
+		int slot = -1;
+		{
+			std::unique_lock<std::mutex> qlock(queueMutex);
+			// the queue is drained before stopping so close() loses no frames
+			queueCondition.wait(qlock, [this] { return !queued.empty() || bStopping; });
+			if (queued.empty()) break;
+			slot = queued.front();
+			queued.pop_front();
+		}
+
+		rasterize(slots[slot].snapshot, slots[slot].image, 30);
+		write(slots[slot]);
+		framesWritten++;
+
+		{
+			std::unique_lock<std::mutex> qlock(queueMutex);
+			freeSlots.push_back(slot);
+		}
+		freeCondition.notify_one();
+	}
+}
+
+//--------------------------------------------------------------
+void OfflineRenderer::write(Slot& aslot) {
+	string path = folder + "/frame_" + ofToString(aslot.snapshot.frameNum, 6, '0');
+	if (format == FORMAT_RAW) {
+		ofstream file(ofToDataPath(path + ".rgb"), ios::binary);
+		file.write((const char*)aslot.image.getData(), width * height * 3);
+		if (!file) {
+			ofLogError("OfflineRenderer") << "couldn't write " << path << ".rgb";
+		}
+	}
+	else {
+		ofSaveImage(aslot.image, path + ".png");
+	}
+}
+
+//--------------------------------------------------------------
+void OfflineRenderer::rasterize(const FrameSnapshot& asnapshot, ofPixels& aimage, int abackground) {
+	unsigned char* data = aimage.getData();
+	memset(data, abackground, aimage.getWidth() * aimage.getHeight() * 3);
+
+	for (int i = 0; i < asnapshot.pixels.size(); i++) {
+		const Pixel& p = asnapshot.pixels[i];
+		fillRect(aimage, p.rect.x, p.rect.y, p.rect.width, p.rect.height, p.color, p.a);
+	}
+
+	for (int i = 0; i < asnapshot.drips.size(); i++) {
+		const Drip& d = asnapshot.drips[i];
+		fillRect(aimage, d.rect.x, d.rect.y, d.rect.width, d.rect.height, d.color, d.a);
+	}
+
+	// EnergyPool::buildMesh() makes each particle two triangles, tl tr br and tl br bl
+	const vector<ofVec3f>& vertices = asnapshot.energyMesh.getVertices();
+	const vector<ofFloatColor>& colors = asnapshot.energyMesh.getColors();
+	for (int v = 0; v + 5 < vertices.size() && v < colors.size(); v += 6) {
+		const ofVec3f& tl = vertices[v];
+		const ofVec3f& br = vertices[v + 2];
+		ofColor c = colors[v];
+		fillRect(aimage, tl.x, tl.y, br.x - tl.x, br.y - tl.y, c, c.a);
+	}
+}
+
+//--------------------------------------------------------------
+void OfflineRenderer::fillRect(ofPixels& aimage, float ax, float ay, float aw, float ah, const ofColor& acolor, int aalpha) {
+	int alpha = ofClamp(aalpha, 0, 255);
+	if (alpha == 0) return;
+
+	int width = aimage.getWidth();
+	int height = aimage.getHeight();
+	// pixels whose centers fall inside the rect, as GL fills them
+	int x0 = max(0, (int)ceil(ax - 0.5f));
+	int x1 = min(width, (int)ceil(ax + aw - 0.5f));
+	int y0 = max(0, (int)ceil(ay - 0.5f));
+	int y1 = min(height, (int)ceil(ay + ah - 0.5f));
+	if (x0 >= x1 || y0 >= y1) return;
+
+	// OF_BLENDMODE_ALPHA: src * a + dst * (1 - a)
+	int r = acolor.r * alpha, g = acolor.g * alpha, b = acolor.b * alpha;
+	int inverse = 255 - alpha;
+	unsigned char* data = aimage.getData();
+	for (int y = y0; y < y1; y++) {
+		unsigned char* px = data + (y * width + x0) * 3;
+		for (int x = x0; x < x1; x++, px += 3) {
+			px[0] = (r + px[0] * inverse + 127) / 255;
+			px[1] = (g + px[1] * inverse + 127) / 255;
+			px[2] = (b + px[2] * inverse + 127) / 255;
+		}
+	}
+}
@@ -0,0 +1,73 @@
+//
+//  OfflineRender.h
+//  MeltingMe
+//
+//  Writes every simulated frame of a replay to an image sequence without a
+//  GPU. The app fills a FrameSnapshot per frame; a pool of worker threads
+//  rasterizes the cells, drips and energies on the CPU the way draw() does
+//  and encodes them as PNG or raw RGB24 files named by frame number.
+//  acquire() blocks while every snapshot is still being worked on, so no
+//  frame is ever skipped.
+//
+//  Raw frames can be turned into a video with
+//    ffmpeg -f image2 -c:v rawvideo -pix_fmt rgb24 -s 1920x1080 -framerate 60 -i frame_%06d.rgb out.mp4
+//
+
+#pragma once
+#include "ofMain.h"
+#include "FramePipeline.h"
+
+class OfflineRenderer {
+public:
+	enum Format {
+		FORMAT_PNG = 0,
+		FORMAT_RAW
+	};
+
+	~OfflineRenderer();
+
+	// creates afolder and starts the workers, 0 threads is one per core
+	bool setup(const string& afolder, Format aformat, int awidth, int aheight, int anumThreads = 0);
+	// waits for the queued frames to be written
+	void close();
+
+	// a snapshot to fill for the next frame, set its frameNum then submit() it
+	FrameSnapshot& acquire();
+	void submit();
+
+	uint64_t getFramesWritten() const;
+	int getNumThreads() const;
+	static Format getFormatForName(const string& aname);
+
+	// draws the snapshot over the background like ofApp::draw()
+	static void rasterize(const FrameSnapshot& asnapshot, ofPixels& aimage, int abackground);
+
+protected:
+	class Slot {
+	public:
+		FrameSnapshot snapshot;
+		ofPixels image;
+	};
+
+	void work();
+	void write(Slot& aslot);
+	// alpha blends a rect the way GL covers pixel centers
+	static void fillRect(ofPixels& aimage, float ax, float ay, float aw, float ah, const ofColor& acolor, int aalpha);
+
+	string folder = "";
+	Format format = FORMAT_PNG;
+	int width = 0;
+	int height = 0;
+
+	vector<Slot> slots;
+	vector<std::thread> workers;
+	std::mutex queueMutex;
+	condition_variable queueCondition;
+	condition_variable freeCondition;
+	deque<int> queued;
+	deque<int> freeSlots;
+	int acquiredSlot = -1;
+	int numBusy = 0;
+	bool bStopping = false;
+	atomic<uint64_t> framesWritten{ 0 };
+};
@@ -0,0 +1,49 @@
+#include "Pixel.h"
+
+//--------------------------------------------------------------
+void Pixel::update() {
+	a -= 50;
+	if (a<0)a = 0;
+	/*if (isLitUp) {
+	a = 255;
+	}*/
+}
+
+void Pixel::draw() const {
+	ofSetColor(color, a);
+	ofDrawRectangle(rect);
+}
+
+//--------------------------------------------------------------
+float Pixel::getCellRandom(unsigned int aframe, unsigned int astream) const {
+	unsigned int h = cellHash ^ (aframe * 2654435761u) ^ (astream * 0x9e3779b9u);
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return (h >> 8) / 16777216.f;
+}
+
+Drip Pixel::createDrip(ofColor c) {
+	Drip d;
+	d.rect = rect;
+	d.color = d.color.lerp(c, 0.3f);
+	return d;
+}
+
+//--------------------------------------------------------------
+void Drip::update(float speed, float dt) {
+	vel += dt * speed;
+	rect.position.y += vel;
+	a -= dt * 300;
+	if (a<0) {
+		a = 0;
+		bRemove = true;
+	}
+}
+
+void Drip::draw() const {
+	ofSetColor(color, a);
+	ofDrawRectangle(rect);
+}
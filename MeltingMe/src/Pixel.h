@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofMain.h"
+
+class Drip {
+public:
+	ofRectangle rect;
+	int a = 255;
+	float vel = 0;
+	ofColor color = ofColor(255);
+	void update(float speed, float dt);
+	void draw() const;
+	bool bRemove = false;
+};
+
+class Pixel {
+public:
+	// the draws getCellRandom() makes for a cell each frame
+	enum RandomStream {
+		RANDOM_ENERGY = 0,
+		// then one more for each further drip due in the frame
+		RANDOM_DRIP
+	};
+
+	ofRectangle rect;
+	bool isLitUp = false;
+	bool isMelting = false;
+	bool isRestoring = false;
+	int a = 0;
+	ofColor color = ofColor(255, 255, 255);
+	void draw() const;
+	void update();
+	Drip createDrip(ofColor c);
+	float preScale = 0;
+	// drips are emitted each time this passes 1, see DripEmitter
+	float dripPhase = 0;
+	// hashed from the cell's column and row, so every shard draws the same
+	// numbers for the same cell
+	unsigned int cellHash = 0;
+	// 0 - 1, the same for a cell, frame and stream on every node
+	float getCellRandom(unsigned int aframe, unsigned int astream) const;
+};
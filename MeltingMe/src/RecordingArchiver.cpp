@@ -0,0 +1,51 @@
+//
+//  RecordingArchiver.cpp
+//  MeltingMe
+//
+
+#include "RecordingArchiver.h"
+#include "RecordingCodec.h"
+
+//--------------------------------------------------------------
+RecordingArchiver::~RecordingArchiver() {
+	waitForThread(false);
+}
+
+//--------------------------------------------------------------
+bool RecordingArchiver::archive(const vector<SkeletonData>& adata, const string& afilePath) {
+	if (isThreadRunning()) {
+		ofLogWarning("RecordingArchiver") << "still writing " << filePath;
+		return false;
+	}
+	// the join is immediate, the last archive already finished
+	waitForThread(false);
+	data = adata;
+	filePath = afilePath;
+	bFinished = false;
+	startThread();
+	return true;
+}
+
+//--------------------------------------------------------------
+bool RecordingArchiver::isArchiving() const {
+	return isThreadRunning();
+}
+
+//--------------------------------------------------------------
+bool RecordingArchiver::fetchFinished() {
+	return bFinished.exchange(false);
+}
+
+//--------------------------------------------------------------
+void RecordingArchiver::threadedFunction() {
+	uint64_t startMillis = ofGetElapsedTimeMillis();
+	if (RecordingCodec::encodeFile(data, filePath)) {
+		ofLogNotice("RecordingArchiver") << "archived " << data.size() << " messages to " << filePath << " in " << (ofGetElapsedTimeMillis() - startMillis) << " ms";
+	}
+	else {
+		ofLogError("RecordingArchiver") << "couldn't write " << filePath;
+	}
+	data.clear();
+	data.shrink_to_fit();
+	bFinished = true;
+}
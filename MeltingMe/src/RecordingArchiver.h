@@ -0,0 +1,31 @@
+//
+//  RecordingArchiver.h
+//  MeltingMe
+//
+//  Writes a copy of a recording to a .mrec archive on a background
+//  thread, so encoding a long recording doesn't stall the show.
+//
+
+#pragma once
+#include "ofMain.h"
+#include "RecordingLoader.h"
+
+class RecordingArchiver : public ofThread {
+public:
+	~RecordingArchiver();
+
+	// copies adata and encodes it to afilePath without blocking the caller,
+	// returns false if an archive is still being written
+	bool archive(const vector<SkeletonData>& adata, const string& afilePath);
+
+	bool isArchiving() const;
+	// true once for every archive that has been written since the last call
+	bool fetchFinished();
+
+protected:
+	void threadedFunction();
+
+	vector<SkeletonData> data;
+	string filePath;
+	atomic<bool> bFinished{ false };
+};
@@ -0,0 +1,501 @@
+//
+//  RecordingCodec.cpp
+//  MeltingMe
+//
+
+#include "RecordingCodec.h"
+#include "FlightRecorder.h"
+#include "Skeleton.h"
+#include <queue>
+
+namespace {
+	enum RecordKind {
+		JOINT = 0,
+		NEW_BODY,
+		RAW
+	};
+
+	// one predictor per body and joint, reset at every block
+	class JointState {
+	public:
+		int32_t pos[3] = { 0, 0, 0 };
+		uint8_t state = FlightRecorder::UNKNOWN;
+	};
+
+	class BodyState {
+	public:
+		string id;
+		JointState joints[Skeleton::TOTAL_JOINTS];
+	};
+
+	//--------------------------------------------------------------
+	void putU32(string& aout, uint32_t v) {
+		for (int i = 0; i < 4; i++) aout.push_back((char)((v >> (i * 8)) & 0xff));
+	}
+
+	uint32_t getU32(const char* p) {
+		uint32_t v = 0;
+		for (int i = 0; i < 4; i++) v |= (uint32_t)(uint8_t)p[i] << (i * 8);
+		return v;
+	}
+
+	void putVarint(string& aout, uint64_t v) {
+		while (v >= 0x80) {
+			aout.push_back((char)(v | 0x80));
+			v >>= 7;
+		}
+		aout.push_back((char)v);
+	}
+
+	void putSigned(string& aout, int64_t v) {
+		putVarint(aout, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+	}
+
+	void putString(string& aout, const string& s) {
+		putVarint(aout, s.size());
+		aout.append(s);
+	}
+
+	class Reader {
+	public:
+		const char* p;
+		const char* end;
+		bool bOk = true;
+
+		uint64_t varint() {
+			uint64_t v = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (p >= end) {
+					bOk = false;
+					return 0;
+				}
+				uint8_t b = *p++;
+				v |= (uint64_t)(b & 0x7f) << shift;
+				if (!(b & 0x80)) return v;
+			}
+			bOk = false;
+			return 0;
+		}
+
+		int64_t svarint() {
+			uint64_t v = varint();
+			return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+		}
+
+		uint8_t byte() {
+			if (p >= end) {
+				bOk = false;
+				return 0;
+			}
+			return *p++;
+		}
+
+		string str() {
+			uint64_t n = varint();
+			if (!bOk || n > (uint64_t)(end - p)) {
+				bOk = false;
+				return "";
+			}
+			string s(p, n);
+			p += n;
+			return s;
+		}
+	};
+
+	//--------------------------------------------------------------
+	// "/bodies/{id}/joints/{name}" with x, y, z and a tracking state
+	bool splitJointMessage(const ofxOscMessage& amsg, string& abodyId, Skeleton::JointIndex& ajoint) {
+		if (amsg.getNumArgs() != 4) return false;
+		if (amsg.getArgType(0) != OFXOSC_TYPE_FLOAT || amsg.getArgType(1) != OFXOSC_TYPE_FLOAT || amsg.getArgType(2) != OFXOSC_TYPE_FLOAT || amsg.getArgType(3) != OFXOSC_TYPE_STRING) return false;
+
+		const string& address = amsg.getAddress();
+		static const string prefix = "/bodies/";
+		static const string middle = "/joints/";
+		if (address.compare(0, prefix.size(), prefix) != 0) return false;
+		size_t idEnd = address.find('/', prefix.size());
+		if (idEnd == string::npos || address.compare(idEnd, middle.size(), middle) != 0) return false;
+
+		ajoint = Skeleton::getIndexForName(address.substr(idEnd + middle.size()));
+		if (ajoint == Skeleton::TOTAL_JOINTS) return false;
+		abodyId = address.substr(prefix.size(), idEnd - prefix.size());
+		return true;
+	}
+
+	int32_t quantize(float v, int units) {
+		return (int32_t)floor(v * (double)units + 0.5);
+	}
+
+	//--------------------------------------------------------------
+	// canonical Huffman over the bytes of a block, codes are at most 15 bits
+	// so their lengths pack into nibbles
+	const int NUM_SYMBOLS = 256;
+	const int MAX_CODE_LENGTH = 15;
+	const int CODE_LENGTH_BYTES = NUM_SYMBOLS / 2;
+	enum BlockCoding {
+		STORED = 0,
+		HUFFMAN
+	};
+
+	void buildCodeLengths(const uint32_t* afreq, uint8_t* alengths) {
+		vector<uint32_t> freq(afreq, afreq + NUM_SYMBOLS);
+		while (true) {
+			memset(alengths, 0, NUM_SYMBOLS);
+			// nodes below NUM_SYMBOLS are leaves
+			vector<int> parent(NUM_SYMBOLS * 2, -1);
+			priority_queue< pair<uint64_t, int>, vector< pair<uint64_t, int> >, greater< pair<uint64_t, int> > > queue;
+			for (int i = 0; i < NUM_SYMBOLS; i++) {
+				if (freq[i]) queue.push(make_pair((uint64_t)freq[i], i));
+			}
+			if (queue.size() == 1) {
+				alengths[queue.top().second] = 1;
+				return;
+			}
+			int next = NUM_SYMBOLS;
+			while (queue.size() > 1) {
+				pair<uint64_t, int> a = queue.top();
+				queue.pop();
+				pair<uint64_t, int> b = queue.top();
+				queue.pop();
+				parent[a.second] = next;
+				parent[b.second] = next;
+				queue.push(make_pair(a.first + b.first, next++));
+			}
+			int maxLength = 0;
+			for (int i = 0; i < NUM_SYMBOLS; i++) {
+				if (!freq[i]) continue;
+				int length = 0;
+				for (int n = i; parent[n] >= 0; n = parent[n]) length++;
+				alengths[i] = length;
+				maxLength = max(maxLength, length);
+			}
+			if (maxLength <= MAX_CODE_LENGTH) return;
+			// too deep, flatten the counts and try again
+			for (int i = 0; i < NUM_SYMBOLS; i++) {
+				if (freq[i]) freq[i] = (freq[i] + 1) / 2;
+			}
+		}
+	}
+
+	// codes in order of length, then symbol, like deflate
+	void buildCodes(const uint8_t* alengths, uint16_t* acodes) {
+		int count[MAX_CODE_LENGTH + 1] = { 0 };
+		for (int i = 0; i < NUM_SYMBOLS; i++) count[alengths[i]]++;
+		count[0] = 0;
+		uint16_t next[MAX_CODE_LENGTH + 2] = { 0 };
+		uint16_t code = 0;
+		for (int length = 1; length <= MAX_CODE_LENGTH; length++) {
+			code = (code + count[length - 1]) << 1;
+			next[length] = code;
+		}
+		for (int i = 0; i < NUM_SYMBOLS; i++) {
+			if (alengths[i]) acodes[i] = next[alengths[i]]++;
+		}
+	}
+
+	void huffmanEncode(const string& ain, string& aout) {
+		uint32_t freq[NUM_SYMBOLS] = { 0 };
+		for (int i = 0; i < ain.size(); i++) freq[(uint8_t)ain[i]]++;
+		uint8_t lengths[NUM_SYMBOLS];
+		uint16_t codes[NUM_SYMBOLS];
+		buildCodeLengths(freq, lengths);
+		buildCodes(lengths, codes);
+
+		aout.clear();
+		aout.push_back((char)HUFFMAN);
+		for (int i = 0; i < NUM_SYMBOLS; i += 2) {
+			aout.push_back((char)(lengths[i] | (lengths[i + 1] << 4)));
+		}
+		uint64_t bits = 0;
+		int numBits = 0;
+		for (int i = 0; i < ain.size(); i++) {
+			uint8_t symbol = ain[i];
+			bits = (bits << lengths[symbol]) | codes[symbol];
+			numBits += lengths[symbol];
+			while (numBits >= 8) {
+				numBits -= 8;
+				aout.push_back((char)(bits >> numBits));
+			}
+		}
+		if (numBits > 0) {
+			aout.push_back((char)(bits << (8 - numBits)));
+		}
+
+		// a block with a flat distribution is left as it is
+		if (aout.size() >= ain.size() + 1) {
+			aout.clear();
+			aout.push_back((char)STORED);
+			aout.append(ain);
+		}
+	}
+
+	bool huffmanDecode(const char* adata, uint32_t asize, uint32_t arawSize, string& aout) {
+		aout.clear();
+		if (asize < 1) return false;
+		if (adata[0] == STORED) {
+			if (asize - 1 != arawSize) return false;
+			aout.assign(adata + 1, arawSize);
+			return true;
+		}
+		if (adata[0] != HUFFMAN || asize < 1 + CODE_LENGTH_BYTES) return false;
+
+		uint8_t lengths[NUM_SYMBOLS];
+		for (int i = 0; i < CODE_LENGTH_BYTES; i++) {
+			lengths[i * 2] = (uint8_t)adata[1 + i] & 0x0f;
+			lengths[i * 2 + 1] = (uint8_t)adata[1 + i] >> 4;
+		}
+		// first code, count and first symbol of each length, as in zlib's puff
+		int count[MAX_CODE_LENGTH + 1] = { 0 };
+		for (int i = 0; i < NUM_SYMBOLS; i++) count[lengths[i]]++;
+		count[0] = 0;
+		int offset[MAX_CODE_LENGTH + 2] = { 0 };
+		for (int length = 1; length <= MAX_CODE_LENGTH; length++) {
+			offset[length + 1] = offset[length] + count[length];
+		}
+		uint8_t symbols[NUM_SYMBOLS];
+		int fill[MAX_CODE_LENGTH + 2];
+		memcpy(fill, offset, sizeof(fill));
+		for (int i = 0; i < NUM_SYMBOLS; i++) {
+			if (lengths[i]) symbols[fill[lengths[i]]++] = i;
+		}
+
+		const uint8_t* p = (const uint8_t*)adata + 1 + CODE_LENGTH_BYTES;
+		const uint8_t* end = (const uint8_t*)adata + asize;
+		aout.resize(arawSize);
+		uint32_t bitBuffer = 0;
+		int numBits = 0;
+		for (uint32_t i = 0; i < arawSize; i++) {
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			int length = 1;
+			for (; length <= MAX_CODE_LENGTH; length++) {
+				if (numBits == 0) {
+					if (p >= end) return false;
+					bitBuffer = *p++;
+					numBits = 8;
+				}
+				numBits--;
+				code |= (bitBuffer >> numBits) & 1;
+				if (code - first < count[length]) {
+					aout[i] = (char)symbols[index + code - first];
+					break;
+				}
+				index += count[length];
+				first = (first + count[length]) << 1;
+				code <<= 1;
+			}
+			if (length > MAX_CODE_LENGTH) return false;
+		}
+		return true;
+	}
+}
+
+//--------------------------------------------------------------
+void RecordingCodec::encode(const vector<SkeletonData>& adata, ofBuffer& aout) {
+	string out;
+	out.append("MREC");
+	out.push_back((char)VERSION);
+	putU32(out, POSITION_UNITS);
+	putU32(out, TIME_UNITS);
+
+	string payload;
+	string coded;
+	vector<BodyState> bodies;
+	int64_t prevTime = 0;
+	int numRecords = 0;
+
+	for (int r = 0; r <= adata.size(); r++) {
+		// close the block, the predictors start over in the next one
+		if (numRecords == RECORDS_PER_BLOCK || (r == adata.size() && numRecords > 0)) {
+			huffmanEncode(payload, coded);
+			putU32(out, coded.size());
+			putU32(out, numRecords);
+			putU32(out, payload.size());
+			out.append(coded);
+			payload.clear();
+			bodies.clear();
+			prevTime = 0;
+			numRecords = 0;
+		}
+		if (r == adata.size()) break;
+
+		const SkeletonData& sdata = adata[r];
+		int64_t time = (int64_t)floor(sdata.time * TIME_UNITS + 0.5);
+		string bodyId;
+		Skeleton::JointIndex joint;
+
+		if (splitJointMessage(sdata.message, bodyId, joint)) {
+			int body = 0;
+			while (body < bodies.size() && bodies[body].id != bodyId) body++;
+			if (body == bodies.size()) {
+				bodies.push_back(BodyState());
+				bodies.back().id = bodyId;
+				putVarint(payload, NEW_BODY);
+				putString(payload, bodyId);
+			}
+
+			putVarint(payload, ((uint64_t)body << 2) | JOINT);
+			putSigned(payload, time - prevTime);
+
+			JointState& js = bodies[body].joints[joint];
+			uint8_t state = FlightRecorder::parseState(sdata.message.getArgAsString(3));
+			// the state is only written where its run ends
+			bool bStateChanged = state != js.state;
+			payload.push_back((char)(joint | (bStateChanged ? 0x80 : 0)));
+			if (bStateChanged) {
+				payload.push_back((char)state);
+				js.state = state;
+			}
+			for (int k = 0; k < 3; k++) {
+				int32_t q = quantize(sdata.message.getArgAsFloat(k), POSITION_UNITS);
+				putSigned(payload, (int64_t)q - js.pos[k]);
+				js.pos[k] = q;
+			}
+		}
+		else {
+			putVarint(payload, RAW);
+			putSigned(payload, time - prevTime);
+			putString(payload, sdata.message.getAddress());
+			putVarint(payload, sdata.message.getNumArgs());
+			for (int k = 0; k < sdata.message.getNumArgs(); k++) {
+				if (sdata.message.getArgType(k) == OFXOSC_TYPE_FLOAT) {
+					float v = sdata.message.getArgAsFloat(k);
+					uint32_t bits;
+					memcpy(&bits, &v, 4);
+					payload.push_back('f');
+					putU32(payload, bits);
+				}
+				else if (sdata.message.getArgType(k) == OFXOSC_TYPE_STRING) {
+					payload.push_back('s');
+					putString(payload, sdata.message.getArgAsString(k));
+				}
+				else if (sdata.message.getArgType(k) == OFXOSC_TYPE_INT32) {
+					payload.push_back('i');
+					putSigned(payload, sdata.message.getArgAsInt(k));
+				}
+				else {
+					// the text format drops other types as well
+					payload.push_back('u');
+				}
+			}
+		}
+		prevTime = time;
+		numRecords++;
+	}
+
+	aout.set(out.data(), out.size());
+}
+
+//--------------------------------------------------------------
+bool RecordingCodec::encodeFile(const vector<SkeletonData>& adata, const string& afilePath) {
+	ofBuffer buffer;
+	encode(adata, buffer);
+	return ofBufferToFile(afilePath, buffer, true);
+}
+
+//--------------------------------------------------------------
+bool RecordingCodec::findBlocks(const char* adata, size_t asize, vector<Block>& aout) {
+	aout.clear();
+	if (asize < HEADER_BYTES || memcmp(adata, "MREC", 4) != 0 || (adata[4] != 1 && adata[4] != VERSION)) return false;
+	if (getU32(adata + 5) != POSITION_UNITS || getU32(adata + 9) != TIME_UNITS) return false;
+	int blockHeaderBytes = adata[4] == 1 ? BLOCK_HEADER_BYTES_V1 : BLOCK_HEADER_BYTES;
+
+	size_t offset = HEADER_BYTES;
+	while (offset + blockHeaderBytes <= asize) {
+		Block b;
+		b.size = getU32(adata + offset);
+		b.numRecords = getU32(adata + offset + 4);
+		if (blockHeaderBytes == BLOCK_HEADER_BYTES) b.rawSize = getU32(adata + offset + 8);
+		b.data = adata + offset + blockHeaderBytes;
+		b.fileBytes = blockHeaderBytes + b.size;
+		offset += b.fileBytes;
+		if (offset > asize) return false;
+		aout.push_back(b);
+	}
+	return offset == asize;
+}
+
+//--------------------------------------------------------------
+bool RecordingCodec::decodeBlock(const Block& ablock, vector<SkeletonData>& aout) {
+	if (ablock.rawSize == 0) {
+		return decodeRecords(ablock.data, ablock.size, ablock.numRecords, aout);
+	}
+	string payload;
+	if (!huffmanDecode(ablock.data, ablock.size, ablock.rawSize, payload)) return false;
+	return decodeRecords(payload.data(), payload.size(), ablock.numRecords, aout);
+}
+
+//--------------------------------------------------------------
+bool RecordingCodec::decodeRecords(const char* adata, uint32_t asize, uint32_t anumRecords, vector<SkeletonData>& aout) {
+	Reader in;
+	in.p = adata;
+	in.end = adata + asize;
+
+	vector<BodyState> bodies;
+	int64_t time = 0;
+	uint32_t numDecoded = 0;
+
+	while (in.bOk && in.p < in.end) {
+		uint64_t header = in.varint();
+		int kind = header & 3;
+
+		if (kind == NEW_BODY) {
+			bodies.push_back(BodyState());
+			bodies.back().id = in.str();
+			continue;
+		}
+
+		time += in.svarint();
+		aout.push_back(SkeletonData());
+		SkeletonData& sdata = aout.back();
+		sdata.time = time / (double)TIME_UNITS;
+
+		if (kind == JOINT) {
+			uint64_t body = header >> 2;
+			uint8_t jointByte = in.byte();
+			int joint = jointByte & 0x7f;
+			if (body >= bodies.size() || joint >= Skeleton::TOTAL_JOINTS) return false;
+
+			JointState& js = bodies[body].joints[joint];
+			if (jointByte & 0x80) js.state = in.byte();
+
+			sdata.message.setAddress("/bodies/" + bodies[body].id + "/joints/" + Skeleton::getNameForIndex((Skeleton::JointIndex)joint));
+			for (int k = 0; k < 3; k++) {
+				js.pos[k] += (int32_t)in.svarint();
+				sdata.message.addFloatArg(js.pos[k] / (float)POSITION_UNITS);
+			}
+			sdata.message.addStringArg(FlightRecorder::getStateName((FlightRecorder::TrackingState)js.state));
+		}
+		else if (kind == RAW) {
+			sdata.message.setAddress(in.str());
+			uint64_t numArgs = in.varint();
+			for (uint64_t k = 0; k < numArgs && in.bOk; k++) {
+				char type = in.byte();
+				if (type == 'f') {
+					if (in.end - in.p < 4) return false;
+					uint32_t bits = getU32(in.p);
+					in.p += 4;
+					float v;
+					memcpy(&v, &bits, 4);
+					sdata.message.addFloatArg(v);
+				}
+				else if (type == 's') {
+					sdata.message.addStringArg(in.str());
+				}
+				else if (type == 'i') {
+					sdata.message.addIntArg((int)in.svarint());
+				}
+			}
+		}
+		else {
+			return false;
+		}
+		numDecoded++;
+	}
+	return in.bOk && numDecoded == anumRecords;
+}
+
+//--------------------------------------------------------------
+bool RecordingCodec::isArchive(const string& afilePath) {
+	return afilePath.size() >= 5 && afilePath.compare(afilePath.size() - 5, 5, ".mrec") == 0;
+}
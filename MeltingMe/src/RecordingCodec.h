@@ -0,0 +1,52 @@
+//
+//  RecordingCodec.h
+//  MeltingMe
+//
+//  Compact archive format (.mrec) for recordings. Joint positions are
+//  quantized to 0.1 mm and delta coded against the previous sample of the
+//  same joint, tracking states are only stored where they change, and
+//  everything is packed as zigzag varints in blocks that decode on their own.
+//  Since version 2 the bytes of each block are then Huffman coded with a
+//  code of their own, stored as 256 code lengths in front of the bits.
+//
+
+#pragma once
+#include "ofMain.h"
+#include "RecordingLoader.h"
+
+class RecordingCodec {
+public:
+	static const int VERSION = 2;
+	static const int HEADER_BYTES = 13;
+	// size and record count, version 2 adds the size before Huffman coding
+	static const int BLOCK_HEADER_BYTES_V1 = 8;
+	static const int BLOCK_HEADER_BYTES = 12;
+	static const int RECORDS_PER_BLOCK = 4096;
+	// 0.1 mm and 0.1 ms
+	static const int POSITION_UNITS = 10000;
+	static const int TIME_UNITS = 10000;
+
+	class Block {
+	public:
+		const char* data = NULL;
+		uint32_t size = 0;
+		uint32_t numRecords = 0;
+		// 0 for version 1 blocks, which aren't Huffman coded
+		uint32_t rawSize = 0;
+		// header included, for progress
+		uint32_t fileBytes = 0;
+	};
+
+	static void encode(const vector<SkeletonData>& adata, ofBuffer& aout);
+	static bool encodeFile(const vector<SkeletonData>& adata, const string& afilePath);
+
+	// false if the header is wrong or a block runs past the end
+	static bool findBlocks(const char* adata, size_t asize, vector<Block>& aout);
+	// appends the records of one block to aout, false if it is corrupt
+	static bool decodeBlock(const Block& ablock, vector<SkeletonData>& aout);
+	static bool isArchive(const string& afilePath);
+
+protected:
+	// the varint records of one block once it's out of its Huffman code
+	static bool decodeRecords(const char* adata, uint32_t asize, uint32_t anumRecords, vector<SkeletonData>& aout);
+};
@@ -0,0 +1,296 @@
+//
+//  RecordingLoader.cpp
+//  MeltingMe
+//
+
+#include "RecordingLoader.h"
+#include "RecordingCodec.h"
+
+//--------------------------------------------------------------
+RecordingLoader::~RecordingLoader() {
+	waitForThread(false);
+}
+
+//--------------------------------------------------------------
+bool RecordingLoader::load(const string& afilePath) {
+	if (isThreadRunning()) return false;
+	waitForThread(false);
+	filePath = afilePath;
+	bytesParsed = 0;
+	bytesTotal = 0;
+	bResultReady = false;
+	result.clear();
+	bReplace = true;
+	startThread();
+	return true;
+}
+
+//--------------------------------------------------------------
+bool RecordingLoader::isLoading() const {
+	return isThreadRunning();
+}
+
+//--------------------------------------------------------------
+float RecordingLoader::getProgress() const {
+	uint64_t total = bytesTotal.load();
+	if (total == 0) return isThreadRunning() ? 0 : 1;
+	return bytesParsed.load() / (float)total;
+}
+
+//--------------------------------------------------------------
+string RecordingLoader::getFilePath() const {
+	return filePath;
+}
+
+//--------------------------------------------------------------
+bool RecordingLoader::fetch(vector<SkeletonData>& adata, bool* abReplaced) {
+	if (!bResultReady) return false;
+	lock();
+	if (bReplace) {
+		adata.swap(result);
+	}
+	else {
+		std::move(result.begin(), result.end(), std::back_inserter(adata));
+	}
+	if (abReplaced) *abReplaced = bReplace;
+	result.clear();
+	bReplace = false;
+	bResultReady = false;
+	unlock();
+	return true;
+}
+
+//--------------------------------------------------------------
+void RecordingLoader::publish(vector< vector<SkeletonData> >& aparts) {
+	size_t numMessages = 0;
+	for (int c = 0; c < aparts.size(); c++) {
+		numMessages += aparts[c].size();
+	}
+	numPublished += numMessages;
+	lock();
+	for (int c = 0; c < aparts.size(); c++) {
+		std::move(aparts[c].begin(), aparts[c].end(), std::back_inserter(result));
+		aparts[c].clear();
+	}
+	bResultReady = true;
+	unlock();
+}
+
+//--------------------------------------------------------------
+void RecordingLoader::threadedFunction() {
+	uint64_t startMillis = ofGetElapsedTimeMillis();
+
+	bool bArchive = RecordingCodec::isArchive(filePath);
+	ofBuffer tbuffer = ofBufferFromFile(filePath, bArchive);
+	bytesTotal = tbuffer.size();
+	numPublished = 0;
+
+	vector< vector<SkeletonData> > parts;
+	if (bArchive) {
+		if (!loadArchive(tbuffer, parts)) {
+			ofLogError("RecordingLoader") << filePath << " is not a valid archive";
+		}
+	}
+	else {
+		loadText(tbuffer, parts);
+		publish(parts);
+	}
+	// an empty or broken file still replaces the old recording
+	lock();
+	if (bReplace) bResultReady = true;
+	unlock();
+
+	ofLogNotice("RecordingLoader") << "loaded " << numPublished << " messages from " << filePath << " in " << (ofGetElapsedTimeMillis() - startMillis) << " ms";
+}
+
+//--------------------------------------------------------------
+void RecordingLoader::loadText(const ofBuffer& abuffer, vector< vector<SkeletonData> >& aparts) {
+	const char* data = abuffer.getData();
+	size_t size = abuffer.size();
+
+	// split at line boundaries so every chunk parses on its own
+	int numChunks = max(1, (int)std::thread::hardware_concurrency());
+	if (size < 1024 * 1024) numChunks = 1;
+	vector<const char*> bounds;
+	bounds.push_back(data);
+	for (int c = 1; c < numChunks; c++) {
+		const char* p = data + size * c / numChunks;
+		p = max(p, bounds.back());
+		const char* nl = (const char*)memchr(p, '\n', data + size - p);
+		bounds.push_back(nl ? nl + 1 : data + size);
+	}
+	bounds.push_back(data + size);
+
+	aparts.assign(numChunks, vector<SkeletonData>());
+	vector<std::thread> workers;
+	for (int c = 1; c < numChunks; c++) {
+		workers.push_back(std::thread(&RecordingLoader::parseChunk, bounds[c], bounds[c + 1], std::ref(aparts[c]), std::ref(bytesParsed)));
+	}
+	parseChunk(bounds[0], bounds[1], aparts[0], bytesParsed);
+	for (int c = 0; c < workers.size(); c++) {
+		workers[c].join();
+	}
+}
+
+//--------------------------------------------------------------
+bool RecordingLoader::loadArchive(const ofBuffer& abuffer, vector< vector<SkeletonData> >& aparts) {
+	vector<RecordingCodec::Block> blocks;
+	if (!RecordingCodec::findBlocks(abuffer.getData(), abuffer.size(), blocks)) return false;
+
+	// blocks decode on their own, each thread takes one block of a batch and
+	// the batch is handed out in order before the next one starts
+	int numThreads = max(1, (int)std::thread::hardware_concurrency());
+	aparts.assign(numThreads, vector<SkeletonData>());
+	atomic<bool> bOk(true);
+	auto decodeOne = [&](size_t ab, int ac) {
+		if (!RecordingCodec::decodeBlock(blocks[ab], aparts[ac])) bOk = false;
+		bytesParsed += blocks[ab].fileBytes;
+	};
+
+	for (size_t first = 0; first < blocks.size() && bOk && isThreadRunning(); first += numThreads) {
+		int numInBatch = min(numThreads, (int)(blocks.size() - first));
+		vector<std::thread> workers;
+		for (int c = 1; c < numInBatch; c++) {
+			workers.push_back(std::thread(decodeOne, first + c, c));
+		}
+		decodeOne(first, 0);
+		for (int c = 0; c < workers.size(); c++) {
+			workers[c].join();
+		}
+		publish(aparts);
+	}
+	return bOk;
+}
+
+//--------------------------------------------------------------
+void RecordingLoader::parseChunk(const char* abegin, const char* aend, vector<SkeletonData>& aout, atomic<uint64_t>& abytesParsed) {
+	// the text format is roughly 80 bytes per message
+	aout.reserve((aend - abegin) / 80 + 1);
+	const char* reported = abegin;
+	const char* line = abegin;
+	while (line < aend) {
+		const char* nl = (const char*)memchr(line, '\n', aend - line);
+		const char* lineEnd = nl ? nl : aend;
+
+		aout.push_back(SkeletonData());
+		if (!parseLine(line, lineEnd, aout.back())) {
+			aout.pop_back();
+		}
+		line = lineEnd + 1;
+
+		if (line - reported > 64 * 1024) {
+			abytesParsed += line - reported;
+			reported = line;
+		}
+	}
+	abytesParsed += min(line, aend) - reported;
+}
+
+//--------------------------------------------------------------
+bool RecordingLoader::parseLine(const char* abegin, const char* aend, SkeletonData& aout) {
+	// files written in text mode on windows end their lines in \r\n
+	if (aend > abegin && aend[-1] == '\r') aend--;
+
+	const char* fields[64];
+	const char* fieldEnds[64];
+	int numFields = 0;
+	const char* p = abegin;
+	while (p < aend && numFields < 64) {
+		const char* bar = (const char*)memchr(p, '|', aend - p);
+		fields[numFields] = p;
+		fieldEnds[numFields] = bar ? bar : aend;
+		numFields++;
+		p = bar ? bar + 1 : aend;
+	}
+
+	if (numFields < 5) return false;
+
+	if (!parseFloat(fields[0], fieldEnds[0], aout.time)) {
+		aout.time = 0;
+	}
+	aout.message.setAddress(string(fields[1], fieldEnds[1]));
+	for (int k = 2; k < numFields; k++) {
+		if (fieldEnds[k] - fields[k] <= 1) continue;
+		char type = fields[k][0];
+		const char* vbegin = fields[k] + 1;
+		if (type == 'f') {
+			float v = 0;
+			parseFloat(vbegin, fieldEnds[k], v);
+			aout.message.addFloatArg(v);
+		}
+		else if (type == 's') {
+			aout.message.addStringArg(string(vbegin, fieldEnds[k]));
+		}
+		else if (type == 'i') {
+			int v = 0;
+			parseInt(vbegin, fieldEnds[k], v);
+			aout.message.addIntArg(v);
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------
+bool RecordingLoader::parseFloat(const char* abegin, const char* aend, float& aout) {
+	const char* p = abegin;
+	bool bNegative = false;
+	if (p < aend && (*p == '-' || *p == '+')) {
+		bNegative = *p == '-';
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int numDigits = 0;
+	for (; p < aend && *p >= '0' && *p <= '9'; p++, numDigits++) {
+		if (mantissa < 100000000000000000ULL) mantissa = mantissa * 10 + (*p - '0');
+		else exponent++;
+	}
+	if (p < aend && *p == '.') {
+		p++;
+		for (; p < aend && *p >= '0' && *p <= '9'; p++, numDigits++) {
+			if (mantissa < 100000000000000000ULL) {
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+			}
+		}
+	}
+	if (numDigits == 0) return false;
+
+	// ofToString switches to scientific notation for small and large values
+	if (p < aend && (*p == 'e' || *p == 'E')) {
+		p++;
+		int e = 0;
+		if (!parseInt(p, aend, e)) return false;
+		exponent += e;
+		p = aend;
+	}
+	if (p != aend) return false;
+
+	double value = (double)mantissa;
+	static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	if (exponent >= 0 && exponent <= 22) value *= powers[exponent];
+	else if (exponent < 0 && exponent >= -22) value /= powers[-exponent];
+	else value *= pow(10.0, exponent);
+
+	aout = (float)(bNegative ? -value : value);
+	return true;
+}
+
+//--------------------------------------------------------------
+bool RecordingLoader::parseInt(const char* abegin, const char* aend, int& aout) {
+	const char* p = abegin;
+	bool bNegative = false;
+	if (p < aend && (*p == '-' || *p == '+')) {
+		bNegative = *p == '-';
+		p++;
+	}
+	if (p == aend) return false;
+	long long value = 0;
+	for (; p < aend; p++) {
+		if (*p < '0' || *p > '9') return false;
+		if (value < 10000000000LL) value = value * 10 + (*p - '0');
+	}
+	aout = (int)(bNegative ? -value : value);
+	return true;
+}
@@ -0,0 +1,60 @@
+//
+//  RecordingLoader.h
+//  MeltingMe
+//
+//  Loads a recording from recordings/ on a background thread, parsing
+//  line-aligned chunks of text files, or the blocks of .mrec archives,
+//  in parallel. Archives are handed out a batch of blocks at a time, so
+//  playback can start on the first seconds while the rest decodes.
+//
+
+#pragma once
+#include "ofMain.h"
+#include "ofxOsc.h"
+
+class SkeletonData {
+public:
+	ofxOscMessage message;
+	float time = 0;
+};
+
+class RecordingLoader : public ofThread {
+public:
+	~RecordingLoader();
+
+	// starts loading afilePath, returns false while another load is running
+	bool load(const string& afilePath);
+
+	bool isLoading() const;
+	// 0 - 1 over the bytes parsed so far
+	float getProgress() const;
+	string getFilePath() const;
+
+	// moves what has been parsed since the last call into adata, returns
+	// false if there is nothing new. the first fetch of a load replaces
+	// adata and sets abReplaced, later ones append to it
+	bool fetch(vector<SkeletonData>& adata, bool* abReplaced = NULL);
+
+	// parses one "time|address|fX|sY|iZ..." line, false if it isn't a message
+	static bool parseLine(const char* abegin, const char* aend, SkeletonData& aout);
+	// locale independent and allocation free, false on anything but a plain number
+	static bool parseFloat(const char* abegin, const char* aend, float& aout);
+	static bool parseInt(const char* abegin, const char* aend, int& aout);
+
+protected:
+	void threadedFunction();
+	void loadText(const ofBuffer& abuffer, vector< vector<SkeletonData> >& aparts);
+	bool loadArchive(const ofBuffer& abuffer, vector< vector<SkeletonData> >& aparts);
+	// appends aparts to what the next fetch hands out
+	void publish(vector< vector<SkeletonData> >& aparts);
+	static void parseChunk(const char* abegin, const char* aend, vector<SkeletonData>& aout, atomic<uint64_t>& abytesParsed);
+
+	string filePath;
+	// guarded by lock()
+	vector<SkeletonData> result;
+	bool bReplace = false;
+	size_t numPublished = 0;
+	atomic<uint64_t> bytesParsed;
+	atomic<uint64_t> bytesTotal;
+	atomic<bool> bResultReady;
+};
@@ -0,0 +1,53 @@
+//
+//  Replay.cpp
+//  MeltingMe
+//
+
+#include "Replay.h"
+
+//--------------------------------------------------------------
+ReplayConfig ReplayConfig::fromArgs(int argc, char* argv[]) {
+	ReplayConfig config;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--replay" && i + 1 < argc) {
+			config.path = argv[++i];
+		}
+		else if (arg == "--replay-fps" && i + 1 < argc) {
+			config.fps = max(1.f, ofToFloat(argv[++i]));
+		}
+		else if (arg == "--headless") {
+			config.bHeadless = true;
+		}
+		else if (arg == "--validate") {
+			config.bValidate = true;
+		}
+		else if (arg == "--render" && i + 1 < argc) {
+			config.renderFolder = argv[++i];
+		}
+		else if (arg == "--render-format" && i + 1 < argc) {
+			config.renderFormat = argv[++i];
+		}
+		else if (arg == "--render-threads" && i + 1 < argc) {
+			config.renderThreads = ofToInt(argv[++i]);
+		}
+	}
+	return config;
+}
+
+//--------------------------------------------------------------
+bool ReplayConfig::isReplaying() const {
+	return path != "";
+}
+
+//--------------------------------------------------------------
+string ReplayConfig::toString() const {
+	if (!isReplaying()) {
+		return "live";
+	}
+	string s = "replay " + path + " at " + ofToString(fps) + " fps";
+	if (bHeadless) s += ", headless";
+	if (bValidate) s += ", validating";
+	if (renderFolder != "") s += ", rendering " + renderFormat + " to " + renderFolder;
+	return s;
+}
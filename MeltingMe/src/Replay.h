@@ -0,0 +1,34 @@
+//
+//  Replay.h
+//  MeltingMe
+//
+//  Command line options for running a recording through the simulation
+//  instead of live input, at a fixed timestep so every run of the same
+//  file produces the same frames:
+//    --replay recordings/2017-05-01.mrec   the recording to play once, then exit
+//    --replay-fps 60                       simulated frames per second of recording
+//    --headless                            no window, frames run as fast as they can
+//    --validate                            check the optimized paths against DualRun, exits 1
+//                                          when a frame diverged, 2 when this build can't validate
+//    --render renders/take1                writes every frame to an image sequence, see OfflineRender.h
+//    --render-format png                   png or raw
+//    --render-threads 8                    encoder threads, one per core by default
+//
+
+#pragma once
+#include "ofMain.h"
+
+class ReplayConfig {
+public:
+	string path = "";
+	float fps = 60;
+	bool bHeadless = false;
+	bool bValidate = false;
+	string renderFolder = "";
+	string renderFormat = "png";
+	int renderThreads = 0;
+
+	static ReplayConfig fromArgs(int argc, char* argv[]);
+	bool isReplaying() const;
+	string toString() const;
+};
@@ -0,0 +1,490 @@
+//
+//  SectionKernel.cpp
+//  MeltingMe
+//
+
+#include "SectionKernel.h"
+#include <random>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MELTING_X86 1
+#include <immintrin.h>
+#endif
+
+// the kernels have to round like ofVec3f, a fused multiply add would not;
+// the app has to be built without contraction too (the default /fp:precise
+// without /arch:AVX2), --verify-kernels catches it when it isn't
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MELTING_TARGET_SSE2
+#define MELTING_TARGET_AVX2
+#else
+#define MELTING_TARGET_SSE2 __attribute__((target("sse2")))
+#define MELTING_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace SectionKernel {
+
+	static Backend detectBackend();
+	static Backend bestBackend = detectBackend();
+	static Backend currentBackend = bestBackend;
+
+	//--------------------------------------------------------------
+	static Backend detectBackend() {
+#ifdef MELTING_X86
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		bool avx2 = false;
+		// the OS has to save the ymm registers too, not just the cpu support them
+		if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		bool sse2 = __builtin_cpu_supports("sse2") != 0;
+		bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+		if (avx2) return AVX2;
+		if (sse2) return SSE2;
+#endif
+		return SCALAR;
+	}
+
+	//--------------------------------------------------------------
+	bool buildSegments(const ofPolyline& aline, Segments& aout) {
+		aout.count = 0;
+		if (aline.isClosed() || aline.size() < 2 || aline.size() > MAX_SEGMENTS + 1) {
+			return false;
+		}
+		for (int k = 0; k + 1 < (int)aline.size(); k++) {
+			const ofPoint& a = aline[k];
+			const ofPoint& b = aline[k + 1];
+			float dx = b.x - a.x;
+			float dy = b.y - a.y;
+			// ofGetClosestPointOnLine divides by length() squared, not by dx * dx + dy * dy
+			float len = sqrt(dx * dx + dy * dy);
+			aout.ax[k] = a.x;
+			aout.ay[k] = a.y;
+			aout.bx[k] = b.x;
+			aout.by[k] = b.y;
+			aout.dx[k] = dx;
+			aout.dy[k] = dy;
+			// collapsed (melted) segments have a zero dot product, so t stays 0
+			// and the closest point is the start point like ofGetClosestPointOnLine
+			aout.len2[k] = (a.x == b.x && a.y == b.y) ? 1.f : len * len;
+			aout.count++;
+		}
+		return true;
+	}
+
+	// Each backend computes, per segment and in this order:
+	//   t = ((px - ax) * dx + (py - ay) * dy) / len2, clamped to [0, 1]
+	//   q = a * (1 - t) + b * t
+	//   d2 = (qx - px)^2 + (qy - py)^2
+	// and a pixel is inside when sqrt(min d2) < radius. That is what
+	// ofGetClosestPointOnLine, ofVec3f::getInterpolated and ofVec3f::distance
+	// do, and IEEE add, mul, div and sqrt round the same in scalar and SIMD.
+
+	//--------------------------------------------------------------
+	static inline float minDist2(const Segments& s, float px, float py) {
+		float best = numeric_limits<float>::max();
+		for (int k = 0; k < s.count; k++) {
+			float wx = px - s.ax[k];
+			float wy = py - s.ay[k];
+			float t = (wx * s.dx[k] + wy * s.dy[k]) / s.len2[k];
+			if (t > 1) t = 1;
+			else if (t < 0) t = 0;
+			float ex = (s.ax[k] * (1 - t) + s.bx[k] * t) - px;
+			float ey = (s.ay[k] * (1 - t) + s.by[k] * t) - py;
+			float d2 = ex * ex + ey * ey;
+			if (d2 < best) best = d2;
+		}
+		return best;
+	}
+
+	//--------------------------------------------------------------
+	static void classifyScalar(const Segments& s, const float* cx, const float* cy, int start, int count, float radius, unsigned char* inside) {
+		for (int i = start; i < count; i++) {
+			inside[i] = sqrt(minDist2(s, cx[i], cy[i])) < radius ? 1 : 0;
+		}
+	}
+
+#ifdef MELTING_X86
+	//--------------------------------------------------------------
+	MELTING_TARGET_SSE2 static inline __m128 minDist2SSE2(const Segments& s, __m128 px, __m128 py) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		__m128 best = _mm_set1_ps(numeric_limits<float>::max());
+		for (int k = 0; k < s.count; k++) {
+			__m128 ax = _mm_set1_ps(s.ax[k]);
+			__m128 ay = _mm_set1_ps(s.ay[k]);
+			__m128 wx = _mm_sub_ps(px, ax);
+			__m128 wy = _mm_sub_ps(py, ay);
+			__m128 t = _mm_div_ps(_mm_add_ps(_mm_mul_ps(wx, _mm_set1_ps(s.dx[k])), _mm_mul_ps(wy, _mm_set1_ps(s.dy[k]))), _mm_set1_ps(s.len2[k]));
+			t = _mm_min_ps(_mm_max_ps(t, zero), one);
+			__m128 u = _mm_sub_ps(one, t);
+			__m128 ex = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(ax, u), _mm_mul_ps(_mm_set1_ps(s.bx[k]), t)), px);
+			__m128 ey = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(ay, u), _mm_mul_ps(_mm_set1_ps(s.by[k]), t)), py);
+			best = _mm_min_ps(best, _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)));
+		}
+		return best;
+	}
+
+	//--------------------------------------------------------------
+	MELTING_TARGET_SSE2 static void classifySSE2(const Segments& s, const float* cx, const float* cy, int count, float radius, unsigned char* inside) {
+		const __m128 vr = _mm_set1_ps(radius);
+		int i = 0;
+		// 8 pixel centers per iteration
+		for (; i + 8 <= count; i += 8) {
+			__m128 d0 = _mm_sqrt_ps(minDist2SSE2(s, _mm_loadu_ps(cx + i), _mm_loadu_ps(cy + i)));
+			__m128 d1 = _mm_sqrt_ps(minDist2SSE2(s, _mm_loadu_ps(cx + i + 4), _mm_loadu_ps(cy + i + 4)));
+			int mask = _mm_movemask_ps(_mm_cmplt_ps(d0, vr)) | (_mm_movemask_ps(_mm_cmplt_ps(d1, vr)) << 4);
+			for (int j = 0; j < 8; j++) {
+				inside[i + j] = (mask >> j) & 1;
+			}
+		}
+		classifyScalar(s, cx, cy, i, count, radius, inside);
+	}
+
+	//--------------------------------------------------------------
+	MELTING_TARGET_AVX2 static inline __m256 minDist2AVX2(const Segments& s, __m256 px, __m256 py) {
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.f);
+		__m256 best = _mm256_set1_ps(numeric_limits<float>::max());
+		for (int k = 0; k < s.count; k++) {
+			__m256 ax = _mm256_set1_ps(s.ax[k]);
+			__m256 ay = _mm256_set1_ps(s.ay[k]);
+			__m256 wx = _mm256_sub_ps(px, ax);
+			__m256 wy = _mm256_sub_ps(py, ay);
+			__m256 t = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(wx, _mm256_set1_ps(s.dx[k])), _mm256_mul_ps(wy, _mm256_set1_ps(s.dy[k]))), _mm256_set1_ps(s.len2[k]));
+			t = _mm256_min_ps(_mm256_max_ps(t, zero), one);
+			__m256 u = _mm256_sub_ps(one, t);
+			// separate mul and add, a fused multiply add would round differently from ofVec3f
+			__m256 ex = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(ax, u), _mm256_mul_ps(_mm256_set1_ps(s.bx[k]), t)), px);
+			__m256 ey = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(ay, u), _mm256_mul_ps(_mm256_set1_ps(s.by[k]), t)), py);
+			best = _mm256_min_ps(best, _mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)));
+		}
+		return best;
+	}
+
+	//--------------------------------------------------------------
+	MELTING_TARGET_AVX2 static void classifyAVX2(const Segments& s, const float* cx, const float* cy, int count, float radius, unsigned char* inside) {
+		const __m256 vr = _mm256_set1_ps(radius);
+		int i = 0;
+		// 16 pixel centers per iteration
+		for (; i + 16 <= count; i += 16) {
+			__m256 d0 = _mm256_sqrt_ps(minDist2AVX2(s, _mm256_loadu_ps(cx + i), _mm256_loadu_ps(cy + i)));
+			__m256 d1 = _mm256_sqrt_ps(minDist2AVX2(s, _mm256_loadu_ps(cx + i + 8), _mm256_loadu_ps(cy + i + 8)));
+			int mask = _mm256_movemask_ps(_mm256_cmp_ps(d0, vr, _CMP_LT_OQ)) | (_mm256_movemask_ps(_mm256_cmp_ps(d1, vr, _CMP_LT_OQ)) << 8);
+			for (int j = 0; j < 16; j++) {
+				inside[i + j] = (mask >> j) & 1;
+			}
+		}
+		classifyScalar(s, cx, cy, i, count, radius, inside);
+	}
+#endif
+
+	//--------------------------------------------------------------
+	void classify(const ofPolyline& aline, const float* cx, const float* cy, int count, float radius, unsigned char* inside) {
+		classify(aline, cx, cy, count, radius, inside, currentBackend);
+	}
+
+	//--------------------------------------------------------------
+	void classify(const ofPolyline& aline, const float* cx, const float* cy, int count, float radius, unsigned char* inside, Backend abackend) {
+		if (count <= 0) return;
+
+		// distance is never negative, so nothing is closer than a non positive radius
+		if (!(radius > 0)) {
+			memset(inside, 0, count);
+			return;
+		}
+
+		// ofPolyline returns the target itself as the closest point of a line with less than 2 vertices
+		if (aline.size() < 2) {
+			memset(inside, 1, count);
+			return;
+		}
+
+		Segments s;
+		if (!buildSegments(aline, s)) {
+			for (int i = 0; i < count; i++) {
+				ofPoint c(cx[i], cy[i]);
+				inside[i] = aline.getClosestPoint(c).distance(c) < radius ? 1 : 0;
+			}
+			return;
+		}
+
+		if (abackend > bestBackend) abackend = bestBackend;
+#ifdef MELTING_X86
+		if (abackend == AVX2) {
+			classifyAVX2(s, cx, cy, count, radius, inside);
+			return;
+		}
+		if (abackend == SSE2) {
+			classifySSE2(s, cx, cy, count, radius, inside);
+			return;
+		}
+#endif
+		classifyScalar(s, cx, cy, 0, count, radius, inside);
+	}
+
+	// how far past the edge a block has to be before it's settled without the
+	// per cell test, well above the float rounding of the distances
+	static const float BLOCK_MARGIN = 0.05f;
+
+	enum Coverage {
+		OUTSIDE = 0,
+		INSIDE,
+		STRADDLES
+	};
+
+	//--------------------------------------------------------------
+	static Block makeBlock(const float* cx, const float* cy, int arows, int acolumn, int arow, int acolumns, int ablockRows) {
+		Block b;
+		b.column = acolumn;
+		b.row = arow;
+		b.columns = acolumns;
+		b.rows = ablockRows;
+		float x0 = numeric_limits<float>::max(), y0 = numeric_limits<float>::max();
+		float x1 = -numeric_limits<float>::max(), y1 = -numeric_limits<float>::max();
+		for (int c = acolumn; c < acolumn + acolumns; c++) {
+			for (int r = arow; r < arow + ablockRows; r++) {
+				int i = c * arows + r;
+				x0 = min(x0, cx[i]);
+				x1 = max(x1, cx[i]);
+				y0 = min(y0, cy[i]);
+				y1 = max(y1, cy[i]);
+			}
+		}
+		b.x = (x0 + x1) * 0.5f;
+		b.y = (y0 + y1) * 0.5f;
+		b.radius = 0.5f * sqrt((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+		return b;
+	}
+
+	//--------------------------------------------------------------
+	void BlockGrid::build(const float* cx, const float* cy, int acolumns, int arows) {
+		columns = acolumns;
+		rows = arows;
+		blocks.clear();
+		quads.clear();
+		quadStart.clear();
+		for (int c = 0; c < columns; c += BLOCK_SIZE) {
+			for (int r = 0; r < rows; r += BLOCK_SIZE) {
+				Block block = makeBlock(cx, cy, rows, c, r, min(BLOCK_SIZE, columns - c), min(BLOCK_SIZE, rows - r));
+				quadStart.push_back(quads.size());
+				for (int qc = c; qc < c + block.columns; qc += QUAD_SIZE) {
+					for (int qr = r; qr < r + block.rows; qr += QUAD_SIZE) {
+						quads.push_back(makeBlock(cx, cy, rows, qc, qr, min(QUAD_SIZE, c + block.columns - qc), min(QUAD_SIZE, r + block.rows - qr)));
+					}
+				}
+				blocks.push_back(block);
+			}
+		}
+		quadStart.push_back(quads.size());
+	}
+
+	//--------------------------------------------------------------
+	static inline Coverage coverBlock(const Segments& s, const Block& b, float radius) {
+		// every center is within b.radius of the block's, so its distance to
+		// the line is within b.radius of the block's too
+		float d = sqrt(minDist2(s, b.x, b.y));
+		if (d - b.radius > radius + BLOCK_MARGIN) return OUTSIDE;
+		if (d + b.radius < radius - BLOCK_MARGIN) return INSIDE;
+		return STRADDLES;
+	}
+
+	//--------------------------------------------------------------
+	static inline void fillBlock(const Block& b, int arows, unsigned char avalue, unsigned char* inside) {
+		for (int c = b.column; c < b.column + b.columns; c++) {
+			memset(inside + c * arows + b.row, avalue, b.rows);
+		}
+	}
+
+	//--------------------------------------------------------------
+	void classifyBlocks(const ofPolyline& aline, const BlockGrid& agrid, const float* cx, const float* cy, float radius, unsigned char* inside, BlockStats* astats) {
+		int count = agrid.columns * agrid.rows;
+		if (count <= 0) return;
+
+		// classify() settles these without any distances
+		if (!(radius > 0) || aline.size() < 2) {
+			classify(aline, cx, cy, count, radius, inside);
+			return;
+		}
+		// and lines too long for the kernel with ofPolyline, cell by cell
+		Segments s;
+		if (!buildSegments(aline, s)) {
+			classify(aline, cx, cy, count, radius, inside);
+			if (astats) astats->exactCells += count;
+			return;
+		}
+
+		// everything starts outside, so rejected blocks cost nothing more
+		memset(inside, 0, count);
+		BlockStats stats;
+		for (int b = 0; b < agrid.blocks.size(); b++) {
+			const Block& block = agrid.blocks[b];
+			Coverage coverage = coverBlock(s, block, radius);
+			if (coverage == OUTSIDE) {
+				stats.rejectedCells += block.columns * block.rows;
+				continue;
+			}
+			if (coverage == INSIDE) {
+				fillBlock(block, agrid.rows, 1, inside);
+				stats.filledCells += block.columns * block.rows;
+				continue;
+			}
+
+			for (int q = agrid.quadStart[b]; q < agrid.quadStart[b + 1]; q++) {
+				const Block& quad = agrid.quads[q];
+				coverage = coverBlock(s, quad, radius);
+				if (coverage == OUTSIDE) {
+					stats.rejectedCells += quad.columns * quad.rows;
+					continue;
+				}
+				if (coverage == INSIDE) {
+					fillBlock(quad, agrid.rows, 1, inside);
+					stats.filledCells += quad.columns * quad.rows;
+					continue;
+				}
+				// the same arithmetic as every backend, so the cells come out as classify() has them
+				for (int c = quad.column; c < quad.column + quad.columns; c++) {
+					int start = c * agrid.rows + quad.row;
+					classifyScalar(s, cx, cy, start, start + quad.rows, radius, inside);
+				}
+				stats.exactCells += quad.columns * quad.rows;
+			}
+		}
+
+		if (astats) {
+			astats->filledCells += stats.filledCells;
+			astats->rejectedCells += stats.rejectedCells;
+			astats->exactCells += stats.exactCells;
+		}
+	}
+
+	//--------------------------------------------------------------
+	Backend getBestBackend() {
+		return bestBackend;
+	}
+
+	//--------------------------------------------------------------
+	Backend getBackend() {
+		return currentBackend;
+	}
+
+	//--------------------------------------------------------------
+	void setBackend(Backend abackend) {
+		currentBackend = abackend > bestBackend ? bestBackend : abackend;
+	}
+
+	//--------------------------------------------------------------
+	string getBackendName(Backend abackend) {
+		switch (abackend) {
+		case SCALAR:
+			return "Scalar";
+		case SSE2:
+			return "SSE2";
+		case AVX2:
+			return "AVX2";
+		default:
+			break;
+		}
+		return "Unknown";
+	}
+
+	//--------------------------------------------------------------
+	int verify(int numPoses, unsigned int aseed) {
+		// its own generator, so running it doesn't change what ofRandom() gives the app
+		mt19937 rng(aseed);
+		auto random = [&rng](float amin, float amax) {
+			return uniform_real_distribution<float>(amin, amax)(rng);
+		};
+
+		// not a multiple of the vector width so the scalar tails get covered too
+		const int numCenters = 1003;
+		vector<float> cx(numCenters), cy(numCenters);
+		vector<unsigned char> inside(numCenters);
+		int mismatches = 0;
+
+		// and a grid laid out like ofApp::buildPixels() for classifyBlocks()
+		const int gridColumns = 120, gridRows = 90;
+		vector<float> gx(gridColumns * gridRows), gy(gridColumns * gridRows);
+		for (int c = 0; c < gridColumns; c++) {
+			for (int r = 0; r < gridRows; r++) {
+				gx[c * gridRows + r] = 1920.f / gridColumns * (c + 0.5f);
+				gy[c * gridRows + r] = 1080.f / gridRows * (r + 0.5f);
+			}
+		}
+		BlockGrid grid;
+		grid.build(&gx[0], &gy[0], gridColumns, gridRows);
+		vector<unsigned char> gridInside(gx.size());
+
+		for (int p = 0; p < numPoses; p++) {
+			ofPolyline line;
+			ofPoint pt(random(0, 1920), random(0, 1080));
+			for (int v = 0; v < MAX_SEGMENTS + 1; v++) {
+				line.addVertex(pt);
+				pt += ofPoint(random(-200, 200), random(-200, 200));
+			}
+			// melting collapses the end of a section onto a single point
+			int keep = (int)random(1, MAX_SEGMENTS + 2);
+			for (int v = keep; v < (int)line.size(); v++) {
+				line.getVertices()[v] = line[keep - 1];
+			}
+
+			float radius = random(0, 120);
+			for (int i = 0; i < numCenters; i++) {
+				cx[i] = random(-100, 2020);
+				cy[i] = random(-100, 1180);
+			}
+			// half the poses put some centers right on the edge, where rounding decides
+			if (p % 2) {
+				for (int i = 0; i < numCenters; i += 3) {
+					ofPoint c(cx[i], cy[i]);
+					ofPoint q = line.getClosestPoint(c);
+					float d = q.distance(c);
+					if (d > 0) {
+						ofPoint edge = q + (c - q) * (radius / d);
+						cx[i] = edge.x;
+						cy[i] = edge.y;
+					}
+				}
+			}
+
+			for (int b = SCALAR; b <= bestBackend; b++) {
+				classify(line, &cx[0], &cy[0], numCenters, radius, &inside[0], (Backend)b);
+				for (int i = 0; i < numCenters; i++) {
+					ofPoint c(cx[i], cy[i]);
+					bool bInside = line.getClosestPoint(c).distance(c) < radius;
+					if (bInside != (inside[i] != 0)) {
+						mismatches++;
+					}
+				}
+			}
+
+			classifyBlocks(line, grid, &gx[0], &gy[0], radius, &gridInside[0]);
+			for (int i = 0; i < (int)gx.size(); i++) {
+				ofPoint c(gx[i], gy[i]);
+				bool bInside = line.getClosestPoint(c).distance(c) < radius;
+				if (bInside != (gridInside[i] != 0)) {
+					mismatches++;
+				}
+			}
+		}
+		return mismatches;
+	}
+}
@@ -0,0 +1,99 @@
+//
+//  SectionKernel.h
+//  MeltingMe
+//
+//  Batched inside/outside test of pixel centers against a body section.
+//
+
+#pragma once
+#include "ofMain.h"
+
+namespace SectionKernel {
+
+	// A section polyline is 5 joints, so 4 segments.
+	static const int MAX_SEGMENTS = 4;
+
+	enum Backend {
+		SCALAR = 0,
+		SSE2,
+		AVX2
+	};
+
+	// Segment end points, direction vectors and squared length, laid out so
+	// one segment can be broadcast against many pixels.
+	class Segments {
+	public:
+		float ax[MAX_SEGMENTS];
+		float ay[MAX_SEGMENTS];
+		float bx[MAX_SEGMENTS];
+		float by[MAX_SEGMENTS];
+		float dx[MAX_SEGMENTS];
+		float dy[MAX_SEGMENTS];
+		// rounded the way ofGetClosestPointOnLine squares the length, 1 for
+		// collapsed segments
+		float len2[MAX_SEGMENTS];
+		int count = 0;
+	};
+
+	// returns false if the line has too many vertices for the kernel
+	bool buildSegments(const ofPolyline& aline, Segments& aout);
+
+	// inside[i] = 1 when (cx[i], cy[i]) is closer than radius to aline, else 0.
+	// Same classification as aline.getClosestPoint(c).distance(c) < radius,
+	// down to the last bit: every backend repeats ofGetClosestPointOnLine's
+	// float operations in its order, so cells on the edge land the same way.
+	void classify(const ofPolyline& aline, const float* cx, const float* cy, int count, float radius, unsigned char* inside);
+	void classify(const ofPolyline& aline, const float* cx, const float* cy, int count, float radius, unsigned char* inside, Backend abackend);
+
+	// A run of grid cells, with the circle around their centers.
+	class Block {
+	public:
+		int column = 0;
+		int row = 0;
+		int columns = 0;
+		int rows = 0;
+		float x = 0;
+		float y = 0;
+		float radius = 0;
+	};
+
+	// The cells of a column major grid (cell index = column * rows + row)
+	// split into 8x8 blocks, and each block into 2x2 quads.
+	class BlockGrid {
+	public:
+		static const int BLOCK_SIZE = 8;
+		static const int QUAD_SIZE = 2;
+
+		void build(const float* cx, const float* cy, int acolumns, int arows);
+
+		int columns = 0;
+		int rows = 0;
+		vector<Block> blocks;
+		// the quads of blocks[b] are quads[quadStart[b]] up to quadStart[b + 1]
+		vector<Block> quads;
+		vector<int> quadStart;
+	};
+
+	// how classifyBlocks() settled the cells of one call
+	class BlockStats {
+	public:
+		int filledCells = 0;
+		int rejectedCells = 0;
+		int exactCells = 0;
+	};
+
+	// Same result as classify() over the whole grid. Blocks and then quads
+	// that are clearly inside or outside are settled at once, only the cells
+	// of quads that straddle the edge get the per cell test.
+	void classifyBlocks(const ofPolyline& aline, const BlockGrid& agrid, const float* cx, const float* cy, float radius, unsigned char* inside, BlockStats* astats = NULL);
+
+	Backend getBestBackend();
+	Backend getBackend();
+	void setBackend(Backend abackend);
+	string getBackendName(Backend abackend);
+
+	// compares every available backend against ofPolyline on poses from its
+	// own generator seeded with aseed, returns the number of mismatching
+	// pixels; run with --verify-kernels
+	int verify(int numPoses, unsigned int aseed);
+}
@@ -0,0 +1,315 @@
+//
+//  SensorFusion.cpp
+//  MeltingMe
+//
+
+#include "SensorFusion.h"
+
+//--------------------------------------------------------------
+bool SensorFusion::Sensor::getNextMessage(ofxOscMessage& amsg) {
+	if (batchedRX) {
+		return batchedRX->getNextMessage(amsg);
+	}
+	if (oscRX->hasWaitingMessages()) {
+		return oscRX->getNextMessage(amsg);
+	}
+	return false;
+}
+
+//--------------------------------------------------------------
+SensorFusion::Detection::Detection() {
+	for (int i = 0; i < Skeleton::TOTAL_JOINTS; i++) {
+		states[i] = FlightRecorder::NOT_TRACKED;
+		updated[i] = false;
+	}
+}
+
+//--------------------------------------------------------------
+bool SensorFusion::Detection::hasSpine() const {
+	return states[Skeleton::SPINE_MID] == FlightRecorder::TRACKED || states[Skeleton::SPINE_MID] == FlightRecorder::INFERRED;
+}
+
+//--------------------------------------------------------------
+ofVec3f SensorFusion::Detection::getSpine() const {
+	return joints[Skeleton::SPINE_MID];
+}
+
+//--------------------------------------------------------------
+bool SensorFusion::setup(const string& aconfigPath) {
+	close();
+
+	if (!ofFile::doesFileExist(aconfigPath)) {
+		return false;
+	}
+
+	ofBuffer buffer = ofBufferFromFile(aconfigPath);
+	for (auto line : buffer.getLines()) {
+		vector<string> parts = ofSplitString(line, " ", true, true);
+		if (parts.empty() || parts[0][0] == '#') continue;
+
+		if (parts[0] == "sensor" && parts.size() >= 6) {
+			Sensor sensor;
+			sensor.port = ofToInt(parts[1]);
+			float yaw = ofToFloat(parts[5]);
+			float pitch = parts.size() >= 7 ? ofToFloat(parts[6]) : 0;
+			float roll = parts.size() >= 8 ? ofToFloat(parts[7]) : 0;
+			// points are row vectors, so these apply in order
+			sensor.transform.rotate(roll, 0, 0, 1);
+			sensor.transform.rotate(pitch, 1, 0, 0);
+			sensor.transform.rotate(yaw, 0, 1, 0);
+			sensor.transform.translate(ofToFloat(parts[2]), ofToFloat(parts[3]), ofToFloat(parts[4]));
+			sensors.push_back(sensor);
+		}
+		else if (parts[0] == "merge" && parts.size() >= 2) {
+			mergeDistance = ofToFloat(parts[1]);
+			splitDistance = mergeDistance * 2;
+		}
+	}
+
+	if (sensors.empty()) {
+		ofLogWarning("SensorFusion") << aconfigPath << " has no sensors";
+		return false;
+	}
+
+	for (int i = 0; i < sensors.size(); i++) {
+		sensors[i].batchedRX = shared_ptr<BatchedOscReceiver>(new BatchedOscReceiver());
+		if (!sensors[i].batchedRX->setup(sensors[i].port)) {
+			sensors[i].batchedRX.reset();
+			sensors[i].oscRX = shared_ptr<ofxOscReceiver>(new ofxOscReceiver());
+			sensors[i].oscRX->setup(sensors[i].port);
+		}
+	}
+
+	ofLogNotice("SensorFusion") << "fusing " << sensors.size() << " sensors, merging spines closer than " << mergeDistance << "m";
+	return true;
+}
+
+//--------------------------------------------------------------
+void SensorFusion::close() {
+	for (int i = 0; i < sensors.size(); i++) {
+		if (sensors[i].batchedRX) sensors[i].batchedRX->close();
+	}
+	sensors.clear();
+	detections.clear();
+	fusedSpines.clear();
+	pending.clear();
+	queue.clear();
+	numFusedBodies = 0;
+	numDetections = 0;
+}
+
+//--------------------------------------------------------------
+void SensorFusion::update(float atime) {
+	ofxOscMessage msg;
+	for (int i = 0; i < sensors.size(); i++) {
+		while (sensors[i].getNextMessage(msg)) {
+			receive(i, msg, atime);
+		}
+	}
+	associate(atime);
+	emit();
+}
+
+//--------------------------------------------------------------
+bool SensorFusion::getNextMessage(ofxOscMessage& amsg) {
+	if (queue.empty()) return false;
+	amsg = queue.front();
+	queue.pop_front();
+	return true;
+}
+
+//--------------------------------------------------------------
+void SensorFusion::receive(int asensor, ofxOscMessage& amsg, float atime) {
+	// /bodies/{bodyId}/joints/{jointId} or /bodies/{bodyId}/hands/{handId}
+	if (Skeleton::splitAddress(amsg.getAddress(), addressParts, 4) < 4 || addressParts[0] != "bodies") {
+		queue.push_back(amsg);
+		return;
+	}
+
+	// the same checks as ofApp::parseMessage(), before anything is read
+	bool bJoint = addressParts[2] == "joints";
+	if (bJoint && (amsg.getNumArgs() < 4 || amsg.getArgType(0) != OFXOSC_TYPE_FLOAT || amsg.getArgType(1) != OFXOSC_TYPE_FLOAT
+		|| amsg.getArgType(2) != OFXOSC_TYPE_FLOAT || amsg.getArgType(3) != OFXOSC_TYPE_STRING)) {
+		numParseErrors++;
+		return;
+	}
+
+	// assigning keeps the key's storage, so a known body is found without allocating
+	detectionKey.first = asensor;
+	detectionKey.second = addressParts[1];
+	Detection& d = detections[detectionKey];
+	d.sensor = asensor;
+	d.bodyId = addressParts[1];
+	d.lastSeen = atime;
+
+	if (!bJoint) {
+		pending.push_back(make_pair(detectionKey, amsg));
+		return;
+	}
+
+	Skeleton::JointIndex joint = Skeleton::getIndexForName(addressParts[3]);
+	if (joint == Skeleton::TOTAL_JOINTS) {
+		return;
+	}
+	ofVec3f pos(amsg.getArgAsFloat(0), amsg.getArgAsFloat(1), amsg.getArgAsFloat(2));
+	d.joints[joint] = pos * sensors[asensor].transform;
+	d.states[joint] = FlightRecorder::parseState(amsg.getArgAsString(3));
+	d.updated[joint] = true;
+}
+
+//--------------------------------------------------------------
+bool SensorFusion::getFusedSpine(uint64_t afusedId, const Detection* aexclude, float atime, ofVec3f& aspine, int* asensorMask) const {
+	ofVec3f sum;
+	int count = 0;
+	int mask = 0;
+	for (auto it = detections.begin(); it != detections.end(); it++) {
+		const Detection& d = it->second;
+		// a sensor that lost the person keeps its last pose until the timeout, that pose is stale
+		if (&d == aexclude || d.fusedId != afusedId || d.lastSeen < atime) continue;
+		mask |= 1 << d.sensor;
+		if (d.hasSpine()) {
+			sum += d.getSpine();
+			count++;
+		}
+	}
+	if (asensorMask) *asensorMask = mask;
+	if (!count) return false;
+	aspine = sum / count;
+	return true;
+}
+
+//--------------------------------------------------------------
+void SensorFusion::associate(float atime) {
+	for (auto it = detections.begin(); it != detections.end();) {
+		if (atime - it->second.lastSeen > timeout) {
+			it = detections.erase(it);
+		}
+		else {
+			it++;
+		}
+	}
+
+	// split off detections that no longer agree with the rest of their body,
+	// the one that moved away from where the body was gets the new id
+	for (auto it = detections.begin(); it != detections.end(); it++) {
+		Detection& d = it->second;
+		ofVec3f spine;
+		if (d.lastSeen < atime) continue;
+		if (d.fusedId && d.hasSpine() && getFusedSpine(d.fusedId, &d, atime, spine) && d.getSpine().distance(spine) > splitDistance) {
+			auto last = fusedSpines.find(d.fusedId);
+			if (last == fusedSpines.end() || d.getSpine().distance(last->second) >= spine.distance(last->second)) {
+				d.fusedId = 0;
+			}
+		}
+	}
+
+	// match new detections to the nearest body the sensor isn't already part of
+	for (auto it = detections.begin(); it != detections.end(); it++) {
+		Detection& d = it->second;
+		if (d.fusedId || !d.hasSpine() || d.lastSeen < atime) continue;
+
+		uint64_t nearestId = 0;
+		float nearest = mergeDistance;
+		for (auto jt = detections.begin(); jt != detections.end(); jt++) {
+			uint64_t candidate = jt->second.fusedId;
+			if (!candidate || candidate == nearestId) continue;
+			ofVec3f spine;
+			int sensorMask = 0;
+			if (!getFusedSpine(candidate, &d, atime, spine, &sensorMask) || (sensorMask & (1 << d.sensor))) continue;
+			float distance = d.getSpine().distance(spine);
+			if (distance < nearest) {
+				nearest = distance;
+				nearestId = candidate;
+			}
+		}
+		d.fusedId = nearestId ? nearestId : nextFusedId++;
+	}
+}
+
+//--------------------------------------------------------------
+void SensorFusion::emit() {
+	// joints seen by several sensors this frame are averaged over the best tracking state among them
+	map< uint64_t, vector<Detection*> > bodies;
+	for (auto it = detections.begin(); it != detections.end(); it++) {
+		if (it->second.fusedId) bodies[it->second.fusedId].push_back(&it->second);
+	}
+	numFusedBodies = bodies.size();
+	numDetections = detections.size();
+	for (auto it = fusedSpines.begin(); it != fusedSpines.end();) {
+		if (!bodies.count(it->first)) {
+			it = fusedSpines.erase(it);
+		}
+		else {
+			it++;
+		}
+	}
+
+	for (auto it = bodies.begin(); it != bodies.end(); it++) {
+		string prefix = "/bodies/" + ofToString(it->first) + "/joints/";
+		vector<Detection*>& members = it->second;
+		for (int j = 0; j < Skeleton::TOTAL_JOINTS; j++) {
+			// members that didn't send the joint this frame only hold its last pose
+			bool updated = false;
+			FlightRecorder::TrackingState best = FlightRecorder::UNKNOWN;
+			for (int m = 0; m < members.size(); m++) {
+				if (!members[m]->updated[j]) continue;
+				updated = true;
+				if (members[m]->states[j] < best) best = members[m]->states[j];
+			}
+			if (!updated) continue;
+
+			ofVec3f sum;
+			int count = 0;
+			for (int m = 0; m < members.size(); m++) {
+				if (members[m]->updated[j] && members[m]->states[j] == best) {
+					sum += members[m]->joints[j];
+					count++;
+				}
+				members[m]->updated[j] = false;
+			}
+
+			ofxOscMessage msg;
+			msg.setAddress(prefix + Skeleton::getNameForIndex((Skeleton::JointIndex)j));
+			msg.addFloatArg(sum.x / count);
+			msg.addFloatArg(sum.y / count);
+			msg.addFloatArg(sum.z / count);
+			msg.addStringArg(FlightRecorder::getStateName(best));
+			queue.push_back(msg);
+
+			if (j == Skeleton::SPINE_MID) {
+				fusedSpines[it->first] = sum / count;
+			}
+		}
+	}
+
+	for (int i = 0; i < pending.size(); i++) {
+		auto it = detections.find(pending[i].first);
+		if (it == detections.end() || !it->second.fusedId) continue;
+		ofxOscMessage& msg = pending[i].second;
+		vector<string> parts = ofSplitString(msg.getAddress(), "/", true);
+		parts[1] = ofToString(it->second.fusedId);
+		msg.setAddress("/" + ofJoinString(parts, "/"));
+		queue.push_back(msg);
+	}
+	pending.clear();
+}
+
+//--------------------------------------------------------------
+int SensorFusion::getNumSensors() const {
+	return sensors.size();
+}
+
+//--------------------------------------------------------------
+int SensorFusion::getNumDetections() const {
+	return numDetections;
+}
+
+//--------------------------------------------------------------
+int SensorFusion::getNumFusedBodies() const {
+	return numFusedBodies;
+}
+
+//--------------------------------------------------------------
+uint64_t SensorFusion::getNumParseErrors() const {
+	return numParseErrors;
+}
@@ -0,0 +1,100 @@
+//
+//  SensorFusion.h
+//  MeltingMe
+//
+//  Merges the OSC of several Kinects into one body space. Each sensor has
+//  its own port and calibration; detections of the same person from
+//  overlapping sensors are matched on their spine joint and sent on as one
+//  fused body, so parseMessage() sees the same /bodies/... messages as with
+//  a single sensor.
+//
+//  sensors.txt:
+//    # port, then where the sensor sits in the shared space:
+//    # x y z in meters, yaw pitch roll in degrees
+//    sensor 12345 0 0 0 0
+//    sensor 12346 3.5 0 0.5 -30
+//    # spine joints closer than this are the same person (meters)
+//    merge 0.4
+//
+
+#pragma once
+#include "ofMain.h"
+#include "ofxOsc.h"
+#include "Skeleton.h"
+#include "BatchedOscReceiver.h"
+#include "FlightRecorder.h"
+
+class SensorFusion {
+public:
+	class Sensor {
+	public:
+		int port = 12345;
+		// camera space of this sensor to the shared space
+		ofMatrix4x4 transform;
+		// used instead of oscRX where recvmmsg is available
+		shared_ptr<BatchedOscReceiver> batchedRX;
+		shared_ptr<ofxOscReceiver> oscRX;
+
+		bool getNextMessage(ofxOscMessage& amsg);
+	};
+
+	// a body as one sensor sees it
+	class Detection {
+	public:
+		int sensor = 0;
+		string bodyId = "";
+		// 0 until it's matched or made a body of its own
+		uint64_t fusedId = 0;
+		float lastSeen = 0;
+		ofVec3f joints[Skeleton::TOTAL_JOINTS];
+		FlightRecorder::TrackingState states[Skeleton::TOTAL_JOINTS];
+		bool updated[Skeleton::TOTAL_JOINTS];
+
+		Detection();
+		bool hasSpine() const;
+		ofVec3f getSpine() const;
+	};
+
+	// returns false without a config, the app then listens on its one port as before
+	bool setup(const string& aconfigPath);
+	void close();
+
+	// drains every sensor, matches the detections and queues the fused messages
+	void update(float atime);
+	bool getNextMessage(ofxOscMessage& amsg);
+
+	int getNumSensors() const;
+	int getNumDetections() const;
+	int getNumFusedBodies() const;
+	uint64_t getNumParseErrors() const;
+
+	float mergeDistance = 0.4f;
+	// a matched detection that wanders this far from the rest of its body is split off
+	float splitDistance = 0.8f;
+	float timeout = 2.f;
+
+protected:
+	void receive(int asensor, ofxOscMessage& amsg, float atime);
+	void associate(float atime);
+	void emit();
+	// the spine of the other detections of afusedId seen at atime, false if there are none
+	bool getFusedSpine(uint64_t afusedId, const Detection* aexclude, float atime, ofVec3f& aspine, int* asensorMask = NULL) const;
+
+	vector<Sensor> sensors;
+	// keyed by sensor index and the sensor's body id
+	map< pair<int, string>, Detection > detections;
+	// non joint messages of detections, sent on once the detection is matched
+	vector< pair< pair<int, string>, ofxOscMessage > > pending;
+	deque<ofxOscMessage> queue;
+	// the parts of the address receive() is on, and its detection key
+	string addressParts[4];
+	pair<int, string> detectionKey;
+	// where each fused body's spine was last sent, to tell which detection moved away
+	map<uint64_t, ofVec3f> fusedSpines;
+	uint64_t nextFusedId = 1;
+	// read by the gui while the pipeline thread updates
+	atomic<int> numFusedBodies{ 0 };
+	atomic<int> numDetections{ 0 };
+	// joint messages with the wrong arguments, dropped like parseMessage() drops them
+	atomic<uint64_t> numParseErrors{ 0 };
+};
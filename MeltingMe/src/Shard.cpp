@@ -0,0 +1,354 @@
+//
+//  Shard.cpp
+//  MeltingMe
+//
+
+#include "Shard.h"
+#include "FlightRecorder.h"
+#include <cassert>
+
+//--------------------------------------------------------------
+ShardConfig ShardConfig::fromArgs(int argc, char* argv[]) {
+	ShardConfig config;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--shard" && i + 1 < argc) {
+			string role = argv[++i];
+			if (role == "ingest") config.role = INGEST;
+			else if (role == "render") config.role = RENDER;
+		}
+		else if (arg == "--shard-targets" && i + 1 < argc) {
+			vector<string> targets = ofSplitString(argv[++i], ",", true, true);
+			for (int t = 0; t < targets.size(); t++) {
+				vector<string> hostPort = ofSplitString(targets[t], ":");
+				if (hostPort.size() == 2) {
+					config.targets.push_back(make_pair(hostPort[0], ofToInt(hostPort[1])));
+				}
+			}
+		}
+		else if (arg == "--shard-port" && i + 1 < argc) {
+			config.port = ofToInt(argv[++i]);
+		}
+		else if (arg == "--shard-region" && i + 4 < argc) {
+			config.regionX0 = ofToInt(argv[++i]);
+			config.regionY0 = ofToInt(argv[++i]);
+			config.regionX1 = ofToInt(argv[++i]);
+			config.regionY1 = ofToInt(argv[++i]);
+		}
+		else if (arg == "--windowed") {
+			config.bWindowed = true;
+		}
+	}
+	return config;
+}
+
+//--------------------------------------------------------------
+string ShardConfig::getError() const {
+	if (role == INGEST && targets.empty()) {
+		return "an ingest node needs --shard-targets host:port,...";
+	}
+	// the window is scaled to the region, an empty one would divide by zero
+	if (role == RENDER && (regionX0 < 0 || regionY0 < 0 || regionX1 <= regionX0 || regionY1 <= regionY0)) {
+		return "a render node needs --shard-region x0 y0 x1 y1 with x0 < x1 and y0 < y1, got " + ofToString(regionX0) + " " + ofToString(regionY0) + " " + ofToString(regionX1) + " " + ofToString(regionY1);
+	}
+	return "";
+}
+
+//--------------------------------------------------------------
+string ShardConfig::toString() const {
+	if (role == INGEST) {
+		string s = "ingest ->";
+		for (int t = 0; t < targets.size(); t++) {
+			s += " " + targets[t].first + ":" + ofToString(targets[t].second);
+		}
+		return s;
+	}
+	if (role == RENDER) {
+		return "render :" + ofToString(port) + " cells " + ofToString(regionX0) + "," + ofToString(regionY0) + " - " + ofToString(regionX1) + "," + ofToString(regionY1);
+	}
+	return "standalone";
+}
+
+//--------------------------------------------------------------
+void ShardFrame::fromSkeletons(const map< string, shared_ptr<Skeleton> >& askeletons) {
+	bodies.resize(askeletons.size());
+	int b = 0;
+	for (auto it = askeletons.begin(); it != askeletons.end(); it++, b++) {
+		Body& body = bodies[b];
+		body.id = FlightRecorder::parseBodyId(it->first);
+		body.color = it->second->color;
+		body.bRestoring = it->second->restoring;
+		body.scale = it->second->scale;
+		body.handLeft = ofVec2f(it->second->getJoint(Skeleton::HAND_LEFT)->pos);
+		body.handRight = ofVec2f(it->second->getJoint(Skeleton::HAND_RIGHT)->pos);
+		for (int s = 0; s < NUM_SECTIONS; s++) {
+			Section& section = body.sections[s];
+			section.numVertices = 0;
+			auto found = it->second->sections.find(GridKernels::getSectionName((GridKernels::SectionType)s));
+			if (found == it->second->sections.end()) continue;
+			section.percentLeft = found->second.percentLeft;
+			section.meltedPoint = ofVec2f(found->second.meltedPoint);
+			section.numVertices = min((int)found->second.line.size(), (int)MAX_VERTICES);
+			for (int v = 0; v < section.numVertices; v++) {
+				section.vertices[v] = ofVec2f(found->second.line[v]);
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------
+void ShardFrame::toSkeletons(map< string, shared_ptr<Skeleton> >& askeletons) const {
+	map< string, shared_ptr<Skeleton> > previous;
+	previous.swap(askeletons);
+
+	for (int b = 0; b < bodies.size(); b++) {
+		const Body& body = bodies[b];
+		string key = ofToString(body.id);
+		shared_ptr<Skeleton> skeleton;
+		if (previous.count(key)) {
+			skeleton = previous[key];
+		}
+		else {
+			skeleton = shared_ptr<Skeleton>(new Skeleton());
+			skeleton->build();
+		}
+		skeleton->color = (Skeleton::Color)body.color;
+		skeleton->restoring = body.bRestoring;
+		skeleton->scale = body.scale;
+		skeleton->getJoint(Skeleton::HAND_LEFT)->pos = body.handLeft;
+		skeleton->getJoint(Skeleton::HAND_RIGHT)->pos = body.handRight;
+		for (int s = 0; s < NUM_SECTIONS; s++) {
+			const Section& section = body.sections[s];
+			if (section.numVertices == 0) continue;
+			Skeleton::BodySection& target = skeleton->sections[GridKernels::getSectionName((GridKernels::SectionType)s)];
+			target.percentLeft = section.percentLeft;
+			target.meltedPoint = section.meltedPoint;
+			target.line.clear();
+			for (int v = 0; v < section.numVertices; v++) {
+				target.line.addVertex(section.vertices[v]);
+			}
+		}
+		askeletons[key] = skeleton;
+	}
+}
+
+//--------------------------------------------------------------
+// every node runs the same build, so the layout is plain memory
+template<class T> static void put(ofBuffer& aout, const T& v) {
+	aout.append((const char*)&v, sizeof(T));
+}
+
+template<class T> static bool get(const char*& p, const char* end, T& v) {
+	if (end - p < (ptrdiff_t)sizeof(T)) return false;
+	memcpy(&v, p, sizeof(T));
+	p += sizeof(T);
+	return true;
+}
+
+//--------------------------------------------------------------
+int ShardFrame::getNumParts() const {
+	int numBodies = min((int)bodies.size(), (int)MAX_BODIES);
+	return max(1, (numBodies + BODIES_PER_PART - 1) / BODIES_PER_PART);
+}
+
+//--------------------------------------------------------------
+void ShardFrame::serialize(int apart, ofBuffer& aout) const {
+	// bodies past the limit are left out, the count has to match what follows
+	uint8_t numBodies = (uint8_t)min((int)bodies.size(), (int)MAX_BODIES);
+	int first = apart * BODIES_PER_PART;
+	uint8_t partBodies = (uint8_t)max(0, min((int)numBodies - first, (int)BODIES_PER_PART));
+
+	aout.clear();
+	aout.append("MLTS", 4);
+	put(aout, frameNum);
+	put(aout, (uint8_t)apart);
+	put(aout, (uint8_t)getNumParts());
+	put(aout, numBodies);
+	put(aout, time);
+	put(aout, dt);
+	put(aout, wallWidth);
+	put(aout, wallHeight);
+	put(aout, numRows);
+	put(aout, numCols);
+	put(aout, dripAcceptRatio);
+	put(aout, partBodies);
+	for (int b = first; b < first + partBodies; b++) {
+		const Body& body = bodies[b];
+		put(aout, body.id);
+		put(aout, body.color);
+		put(aout, (uint8_t)body.bRestoring);
+		put(aout, body.scale);
+		put(aout, body.handLeft);
+		put(aout, body.handRight);
+		for (int s = 0; s < NUM_SECTIONS; s++) {
+			const Section& section = body.sections[s];
+			put(aout, section.numVertices);
+			put(aout, section.percentLeft);
+			put(aout, section.meltedPoint);
+			for (int v = 0; v < section.numVertices; v++) {
+				put(aout, section.vertices[v]);
+			}
+		}
+	}
+	assert(aout.size() <= MAX_PART_BYTES);
+}
+
+//--------------------------------------------------------------
+bool ShardFrame::readFrameNum(const ofBuffer& ain, uint32_t& aframeNum) {
+	const char* p = ain.getData();
+	const char* end = p + ain.size();
+	if (ain.size() < 4 || memcmp(p, "MLTS", 4) != 0) return false;
+	p += 4;
+	return get(p, end, aframeNum);
+}
+
+//--------------------------------------------------------------
+bool ShardFrame::deserialize(const ofBuffer& ain, int& apart, int& anumParts) {
+	const char* p = ain.getData();
+	const char* end = p + ain.size();
+	if (ain.size() < 4 || memcmp(p, "MLTS", 4) != 0) return false;
+	p += 4;
+
+	uint8_t part = 0, numParts = 0, numBodies = 0, partBodies = 0;
+	if (!get(p, end, frameNum) || !get(p, end, part) || !get(p, end, numParts) || !get(p, end, numBodies)) return false;
+	if (!get(p, end, time) || !get(p, end, dt)) return false;
+	if (!get(p, end, wallWidth) || !get(p, end, wallHeight) || !get(p, end, numRows) || !get(p, end, numCols)) return false;
+	if (!get(p, end, dripAcceptRatio)) return false;
+	if (!get(p, end, partBodies)) return false;
+
+	// the sender splits the same way, anything else is a corrupt part
+	int first = part * BODIES_PER_PART;
+	if (numParts != max(1, (numBodies + BODIES_PER_PART - 1) / BODIES_PER_PART) || part >= numParts) return false;
+	if (partBodies != min((int)numBodies - first, (int)BODIES_PER_PART)) return false;
+
+	bodies.resize(numBodies);
+	for (int b = first; b < first + partBodies; b++) {
+		Body& body = bodies[b];
+		uint8_t restoring = 0;
+		if (!get(p, end, body.id) || !get(p, end, body.color) || !get(p, end, restoring) || !get(p, end, body.scale)) return false;
+		if (!get(p, end, body.handLeft) || !get(p, end, body.handRight)) return false;
+		body.bRestoring = restoring != 0;
+		for (int s = 0; s < NUM_SECTIONS; s++) {
+			Section& section = body.sections[s];
+			if (!get(p, end, section.numVertices) || section.numVertices > MAX_VERTICES) return false;
+			if (!get(p, end, section.percentLeft) || !get(p, end, section.meltedPoint)) return false;
+			for (int v = 0; v < section.numVertices; v++) {
+				if (!get(p, end, section.vertices[v])) return false;
+			}
+		}
+	}
+	apart = part;
+	anumParts = numParts;
+	return p == end;
+}
+
+//--------------------------------------------------------------
+int ShardFrame::verify() {
+	ShardFrame frame;
+	frame.frameNum = 7;
+	frame.bodies.resize(MAX_BODIES);
+	for (int b = 0; b < MAX_BODIES; b++) {
+		Body& body = frame.bodies[b];
+		body.id = 72057594037927936ull + b;
+		body.scale = b;
+		for (int s = 0; s < NUM_SECTIONS; s++) {
+			body.sections[s].numVertices = MAX_VERTICES;
+			for (int v = 0; v < MAX_VERTICES; v++) {
+				body.sections[s].vertices[v] = ofVec2f(b, s * MAX_VERTICES + v);
+			}
+		}
+	}
+
+	int failures = 0;
+	ShardFrame received;
+	ofBuffer buffer;
+	for (int part = 0; part < frame.getNumParts(); part++) {
+		frame.serialize(part, buffer);
+		int readPart = -1, numParts = 0;
+		if (buffer.size() > MAX_PART_BYTES || !received.deserialize(buffer, readPart, numParts) || readPart != part || numParts != frame.getNumParts()) {
+			failures++;
+		}
+	}
+	for (int b = 0; b < received.bodies.size() && b < MAX_BODIES; b++) {
+		const Body& body = received.bodies[b];
+		const ofVec2f& last = body.sections[NUM_SECTIONS - 1].vertices[MAX_VERTICES - 1];
+		if (body.id != frame.bodies[b].id || last.x != b || last.y != NUM_SECTIONS * MAX_VERTICES - 1) {
+			failures++;
+		}
+	}
+	if (received.bodies.size() != MAX_BODIES) failures++;
+	return failures;
+}
+
+//--------------------------------------------------------------
+void ShardLink::setup(const ShardConfig& aconfig) {
+	config = aconfig;
+	if (config.role == ShardConfig::INGEST) {
+		for (int t = 0; t < config.targets.size(); t++) {
+			shared_ptr<ofxOscSender> sender(new ofxOscSender());
+			sender->setup(config.targets[t].first, config.targets[t].second);
+			senders.push_back(sender);
+		}
+	}
+	else if (config.role == ShardConfig::RENDER) {
+		receiver.setup(config.port);
+	}
+}
+
+//--------------------------------------------------------------
+void ShardLink::send(const ShardFrame& aframe) {
+	if (aframe.bodies.size() > ShardFrame::MAX_BODIES && !bWarnedBodies) {
+		ofLogWarning("ShardLink") << "only the first " << ShardFrame::MAX_BODIES << " of " << aframe.bodies.size() << " bodies go to the render nodes";
+		bWarnedBodies = true;
+	}
+	// one datagram per part, each fits the render node's receive buffer
+	for (int part = 0; part < aframe.getNumParts(); part++) {
+		aframe.serialize(part, sendBuffer);
+		ofxOscMessage msg;
+		msg.setAddress("/melting/shard");
+		msg.addBlobArg(sendBuffer);
+		for (int t = 0; t < senders.size(); t++) {
+			senders[t]->sendMessage(msg, false);
+		}
+	}
+}
+
+//--------------------------------------------------------------
+bool ShardLink::receive(ShardFrame& aframe) {
+	static_assert(ShardFrame::MAX_PARTS <= 32, "the parts of a frame are tracked in one uint32_t");
+	ofxOscMessage msg;
+	while (receiver.hasWaitingMessages()) {
+		receiver.getNextMessage(msg);
+		if (msg.getAddress() != "/melting/shard" || msg.getNumArgs() != 1 || msg.getArgType(0) != OFXOSC_TYPE_BLOB) continue;
+
+		const ofBuffer& blob = msg.getArgAsBlob(0);
+		uint32_t frameNum = 0;
+		if (!ShardFrame::readFrameNum(blob, frameNum)) continue;
+		// late packets would step the simulation backwards
+		if (bHasFrame && frameNum <= lastFrameNum) continue;
+		if (bAssembling && frameNum < incoming.frameNum) continue;
+		// a newer frame gives up on the one still missing parts, its time goes into the newer one's dt
+		if (!bAssembling || frameNum > incoming.frameNum) {
+			bAssembling = true;
+			partsReceived = 0;
+		}
+
+		int part = 0, numParts = 0;
+		if (!incoming.deserialize(blob, part, numParts)) continue;
+		partsReceived |= 1u << part;
+		if (partsReceived != (1u << numParts) - 1) continue;
+		bAssembling = false;
+
+		aframe = incoming;
+		if (bHasFrame && aframe.frameNum > lastFrameNum + 1) {
+			numSkippedFrames += aframe.frameNum - lastFrameNum - 1;
+			// the neighbours stepped the lost frames, so this node steps their time
+			aframe.dt = max(aframe.dt, aframe.time - lastTime);
+		}
+		lastFrameNum = aframe.frameNum;
+		lastTime = aframe.time;
+		bHasFrame = true;
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,135 @@
+//
+//  Shard.h
+//  MeltingMe
+//
+//  Splits a wall across several PCs. The ingest node receives the Kinect
+//  OSC, melts the skeletons and sends every frame's body state to the
+//  render nodes; each render node simulates and draws only its own
+//  rectangle of the pixel grid. A frame goes out as several /melting/shard
+//  messages that each fit one datagram, and is stepped once all of them
+//  are in.
+//
+
+#pragma once
+#include "ofMain.h"
+#include "ofxOsc.h"
+#include "Skeleton.h"
+#include "GridKernels.h"
+
+class ShardConfig {
+public:
+	enum Role {
+		STANDALONE = 0,
+		INGEST,
+		RENDER
+	};
+
+	Role role = STANDALONE;
+	// ingest: where the frames go
+	vector< pair<string, int> > targets;
+	// render: where the frames arrive, and the cells this node owns
+	int port = 12400;
+	int regionX0 = 0, regionY0 = 0, regionX1 = 0, regionY1 = 0;
+	bool bWindowed = false;
+
+	// --shard ingest --shard-targets 127.0.0.1:12400,127.0.0.1:12401
+	// --shard render --shard-port 12400 --shard-region x0 y0 x1 y1
+	// --windowed
+	static ShardConfig fromArgs(int argc, char* argv[]);
+	// why the node can't run with these arguments, empty if it can
+	string getError() const;
+	string toString() const;
+};
+
+// The body state of one simulated frame, everything updatePixels() reads.
+class ShardFrame {
+public:
+	// in GridKernels::SectionType order
+	static const int NUM_SECTIONS = GridKernels::TOTAL_SECTIONS;
+	static const int MAX_VERTICES = 5;
+	// the body count goes out as one byte
+	static const int MAX_BODIES = 255;
+	// magic, frame number, part, part count, body count, the seven floats and the part's body count
+	static const int HEADER_BYTES = 4 + 4 + 1 + 1 + 1 + 7 * 4 + 1;
+	// id, color, restoring, scale, hands, then each section with all its vertices
+	static const int MAX_BODY_BYTES = 8 + 1 + 1 + 4 + 2 * 8 + NUM_SECTIONS * (1 + 4 + 8 + MAX_VERTICES * 8);
+	// oscpack reads a datagram into this many bytes, anything longer arrives cut short
+	static const int RECEIVE_BUFFER_BYTES = 4098;
+	// "/melting/shard", the ",b" type tags and the blob size, each padded to four bytes
+	static const int OSC_OVERHEAD_BYTES = 16 + 4 + 4;
+	static const int MAX_PART_BYTES = (RECEIVE_BUFFER_BYTES - OSC_OVERHEAD_BYTES) / 4 * 4;
+	static const int BODIES_PER_PART = (MAX_PART_BYTES - HEADER_BYTES) / MAX_BODY_BYTES;
+	static const int MAX_PARTS = (MAX_BODIES + BODIES_PER_PART - 1) / BODIES_PER_PART;
+
+	class Section {
+	public:
+		float percentLeft = 1;
+		ofVec2f meltedPoint;
+		ofVec2f vertices[MAX_VERTICES];
+		uint8_t numVertices = 0;
+	};
+
+	class Body {
+	public:
+		uint64_t id = 0;
+		uint8_t color = 0;
+		bool bRestoring = false;
+		float scale = 0;
+		ofVec2f handLeft, handRight;
+		Section sections[NUM_SECTIONS];
+	};
+
+	uint32_t frameNum = 0;
+	float time = 0;
+	float dt = 0;
+	float wallWidth = 0, wallHeight = 0;
+	float numRows = 0, numCols = 0;
+	// DripEmitter::acceptRatio of the ingest node, over the whole wall
+	float dripAcceptRatio = 1;
+	vector<Body> bodies;
+
+	void fromSkeletons(const map< string, shared_ptr<Skeleton> >& askeletons);
+	// replaces askeletons with the bodies of this frame, reusing matching ones
+	void toSkeletons(map< string, shared_ptr<Skeleton> >& askeletons) const;
+
+	// at least one, the bodies are spread over the parts in order
+	int getNumParts() const;
+	// the header and part apart's share of the bodies, at most MAX_PART_BYTES
+	void serialize(int apart, ofBuffer& aout) const;
+	// reads one part into this frame, which keeps the bodies of the other
+	// parts; apart and anumParts say which part it was
+	bool deserialize(const ofBuffer& ain, int& apart, int& anumParts);
+	// the frame a part belongs to, false if it isn't one
+	static bool readFrameNum(const ofBuffer& ain, uint32_t& aframeNum);
+
+	// serializes MAX_BODIES bodies of MAX_VERTICES vertices and reads them back,
+	// returns the number of parts that were too long or didn't survive the trip
+	static int verify();
+};
+
+class ShardLink {
+public:
+	void setup(const ShardConfig& aconfig);
+	void send(const ShardFrame& aframe);
+	// hands out the frames that came in one per call and in order, so each
+	// one is stepped; a frame after lost ones takes over their time in its
+	// dt. Returns false once nothing newer than the last frame is waiting.
+	bool receive(ShardFrame& aframe);
+
+	uint32_t lastFrameNum = 0;
+	// lost on the network or missing a part, their time is still stepped
+	int numSkippedFrames = 0;
+
+protected:
+	ShardConfig config;
+	vector< shared_ptr<ofxOscSender> > senders;
+	ofxOscReceiver receiver;
+	ofBuffer sendBuffer;
+	bool bWarnedBodies = false;
+	// the frame whose parts are arriving, a part of a newer one drops it
+	ShardFrame incoming;
+	bool bAssembling = false;
+	uint32_t partsReceived = 0;
+	bool bHasFrame = false;
+	float lastTime = 0;
+};
@@ -17,53 +17,21 @@ void Skeleton::build() {
 }
 
 //--------------------------------------------------------------
-void Skeleton::draw() {
-
-	ofPolyline l;
-
-	l.addVertex(ofVec2f(getJoint(FOOT_LEFT)->pos));
-	l.addVertex(ofVec2f(getJoint(ANKLE_LEFT)->pos));
-	l.addVertex(ofVec2f(getJoint(KNEE_LEFT)->pos));
-	l.addVertex(ofVec2f(getJoint(HIP_LEFT)->pos));
-	l.addVertex(ofVec2f(getJoint(SPINE_BASE)->pos));
-	sections["LeftLeg"].line = l;
-	l.clear();
-
-	l.addVertex(ofVec2f(getJoint(FOOT_RIGHT)->pos));
-	l.addVertex(ofVec2f(getJoint(ANKLE_RIGHT)->pos));
-	l.addVertex(ofVec2f(getJoint(KNEE_RIGHT)->pos));
-	l.addVertex(ofVec2f(getJoint(HIP_RIGHT)->pos));
-	l.addVertex(ofVec2f(getJoint(SPINE_BASE)->pos));
-	sections["RightLeg"].line = l;
-	l.clear();
-
-	l.addVertex(ofVec2f(getJoint(HAND_TIP_LEFT)->pos));
-	l.addVertex(ofVec2f(getJoint(HAND_LEFT)->pos));
-	l.addVertex(ofVec2f(getJoint(WRIST_LEFT)->pos));
-	l.addVertex(ofVec2f(getJoint(ELBOW_LEFT)->pos));
-	l.addVertex(ofVec2f(getJoint(SHOULDER_LEFT)->pos));
-	//    l.addVertex( ofVec2f(getJoint(SPINE_SHOULDER)->pos) );
-	sections["LeftArm"].line = l;
-	l.clear();
-
-	l.addVertex(ofVec2f(getJoint(HAND_TIP_RIGHT)->pos));
-	l.addVertex(ofVec2f(getJoint(HAND_RIGHT)->pos));
-	l.addVertex(ofVec2f(getJoint(WRIST_RIGHT)->pos));
-	l.addVertex(ofVec2f(getJoint(ELBOW_RIGHT)->pos));
-	l.addVertex(ofVec2f(getJoint(SHOULDER_RIGHT)->pos));
-	//    l.addVertex( ofVec2f(getJoint(SPINE_SHOULDER)->pos) );
-	sections["RightArm"].line = l;
-	l.clear();
-
-	l.addVertex(ofVec2f(getJoint(SPINE_BASE)->pos));
-	l.addVertex(ofVec2f(getJoint(SPINE_MID)->pos));
-	l.addVertex(ofVec2f(getJoint(SPINE_SHOULDER)->pos));
-	l.addVertex(ofVec2f(getJoint(NECK)->pos));
-	l.addVertex(ofVec2f(getJoint(HEAD)->pos));
-	sections["Spine"].line = l;
-	l.clear();
-
-	restoringSpeed = ofGetLastFrameTime() * 0.5f;
+void Skeleton::update(float dt) {
+	static const JointIndex leftLeg[] = { FOOT_LEFT, ANKLE_LEFT, KNEE_LEFT, HIP_LEFT, SPINE_BASE };
+	static const JointIndex rightLeg[] = { FOOT_RIGHT, ANKLE_RIGHT, KNEE_RIGHT, HIP_RIGHT, SPINE_BASE };
+	static const JointIndex leftArm[] = { HAND_TIP_LEFT, HAND_LEFT, WRIST_LEFT, ELBOW_LEFT, SHOULDER_LEFT };
+	static const JointIndex rightArm[] = { HAND_TIP_RIGHT, HAND_RIGHT, WRIST_RIGHT, ELBOW_RIGHT, SHOULDER_RIGHT };
+	static const JointIndex spine[] = { SPINE_BASE, SPINE_MID, SPINE_SHOULDER, NECK, HEAD };
+
+	// rebuilt in place so the lines keep their storage from frame to frame
+	setLine(sections["LeftLeg"].line, leftLeg, 5);
+	setLine(sections["RightLeg"].line, rightLeg, 5);
+	setLine(sections["LeftArm"].line, leftArm, 5);
+	setLine(sections["RightArm"].line, rightArm, 5);
+	setLine(sections["Spine"].line, spine, 5);
+
+	restoringSpeed = dt * 0.5f;
 
 	if (restoring) {
 		sections["LeftLeg"].updatePercent(restoringSpeed);
@@ -102,7 +70,10 @@ void Skeleton::draw() {
 			sections["RightLeg"].updatePercent(0);
 		}
 	}
+}
 
+//--------------------------------------------------------------
+void Skeleton::draw() {
 	/*for(auto& line: sections){
 	line.second.line.draw();
 	}
@@ -147,95 +118,104 @@ void Skeleton::BodySection::updatePercent(float amount) {
 }
 
 //--------------------------------------------------------------
-shared_ptr <Skeleton::Joint> Skeleton::getJoint(string jointName) {
-	for (auto joint : joints) {
-		if (joint.first == jointName) {
-			return joint.second;
-		}
+void Skeleton::setLine(ofPolyline& aline, const JointIndex* ajoints, int acount) {
+	aline.clear();
+	for (int i = 0; i < acount; i++) {
+		aline.addVertex(ofVec2f(getJoint(ajoints[i])->pos));
+	}
+}
+
+//--------------------------------------------------------------
+shared_ptr<Skeleton> Skeleton::clone() const {
+	shared_ptr<Skeleton> copy(new Skeleton(*this));
+	for (auto it = copy->joints.begin(); it != copy->joints.end(); it++) {
+		it->second = shared_ptr<Joint>(new Joint(*it->second));
+		JointIndex index = getIndexForName(it->first);
+		if (index != TOTAL_JOINTS) copy->jointsByIndex[index] = it->second;
+	}
+	return copy;
+}
+
+//--------------------------------------------------------------
+shared_ptr <Skeleton::Joint> Skeleton::getJoint(const string& jointName) {
+	auto it = joints.find(jointName);
+	if (it != joints.end()) {
+		return it->second;
 	}
 	return shared_ptr<Joint>();
 }
 
 //--------------------------------------------------------------
 shared_ptr <Skeleton::Joint> Skeleton::getJoint(JointIndex aJointIndex) {
+	if (aJointIndex >= 0 && aJointIndex < TOTAL_JOINTS && jointsByIndex[aJointIndex]) {
+		return jointsByIndex[aJointIndex];
+	}
 	return getJoint(getNameForIndex(aJointIndex));
 }
 
 //--------------------------------------------------------------
-string Skeleton::getNameForIndex(JointIndex aindex) {
-	switch (aindex) {
-	case SPINE_BASE:
-		return "SpineBase";
-	case SPINE_MID:
-		return "SpineMid";
-	case SPINE_SHOULDER:
-		return "SpineShoulder";
-	case NECK:
-		return "Neck";
-	case HEAD:
-		return "Head";
-	case SHOULDER_LEFT:
-		return "ShoulderLeft";
-	case ELBOW_LEFT:
-		return "ElbowLeft";
-	case WRIST_LEFT:
-		return "WristLeft";
-	case HAND_LEFT:
-		return "HandLeft";
-	case HAND_TIP_LEFT:
-		return "HandTipLeft";
-	case THUMB_LEFT:
-		return "ThumbLeft";
-	case SHOULDER_RIGHT:
-		return "ShoulderRight";
-	case ELBOW_RIGHT:
-		return "ElbowRight";
-	case WRIST_RIGHT:
-		return "WristRight";
-	case HAND_RIGHT:
-		return "HandRight";
-	case HAND_TIP_RIGHT:
-		return "HandTipRight";
-	case THUMB_RIGHT:
-		return "ThumbRight";
-	case HIP_LEFT:
-		return "HipLeft";
-	case KNEE_LEFT:
-		return "KneeLeft";
-	case ANKLE_LEFT:
-		return "AnkleLeft";
-	case FOOT_LEFT:
-		return "FootLeft";
-	case HIP_RIGHT:
-		return "HipRight";
-	case KNEE_RIGHT:
-		return "KneeRight";
-	case ANKLE_RIGHT:
-		return "AnkleRight";
-	case FOOT_RIGHT:
-		return "FootRight";
-	default:
-		return "Unknown";
+const string& Skeleton::getNameForIndex(JointIndex aindex) {
+	// made once, callers look names up every frame
+	static const string names[TOTAL_JOINTS + 1] = {
+		"SpineBase", "SpineMid", "SpineShoulder", "Neck", "Head",
+		"ShoulderLeft", "ElbowLeft", "WristLeft", "HandLeft", "HandTipLeft",
+		"ThumbLeft", "ShoulderRight", "ElbowRight", "WristRight", "HandRight",
+		"HandTipRight", "ThumbRight", "HipLeft", "KneeLeft", "AnkleLeft",
+		"FootLeft", "HipRight", "KneeRight", "AnkleRight", "FootRight",
+		"Unknown"
+	};
+	if (aindex < 0 || aindex >= TOTAL_JOINTS) {
+		return names[TOTAL_JOINTS];
+	}
+	return names[aindex];
+}
 
+//--------------------------------------------------------------
+Skeleton::JointIndex Skeleton::getIndexForName(const string& aname) {
+	for (int i = 0; i < TOTAL_JOINTS; i++) {
+		if (getNameForIndex((JointIndex)i) == aname) {
+			return (JointIndex)i;
+		}
+	}
+	return TOTAL_JOINTS;
+}
+
+//--------------------------------------------------------------
+int Skeleton::splitAddress(const string& aaddress, string* aparts, int amaxParts) {
+	// the leading '/' is skipped and a trailing one ends the last part, like getline
+	int numParts = 0;
+	size_t start = (aaddress.size() > 0 && aaddress[0] == '/') ? 1 : 0;
+	while (start < aaddress.size()) {
+		size_t end = aaddress.find('/', start);
+		if (end == string::npos) end = aaddress.size();
+		if (numParts < amaxParts) {
+			aparts[numParts].assign(aaddress, start, end - start);
+		}
+		numParts++;
+		start = end + 1;
 	}
-	return "Unknown";
+	return numParts;
 }
 
 
 //--------------------------------------------------------------
-void Skeleton::addOrUpdateJoint(string jointName, ofVec3f position, bool seen, float imageScale, int offsetX, int offsetY) {
+void Skeleton::addOrUpdateJoint(const string& jointName, ofVec3f position, bool seen, float imageScale, int offsetX, int offsetY) {
 
-	if (joints.count(jointName) == 0) {
+	auto it = joints.find(jointName);
+	if (it == joints.end()) {
 		//        ofLogError() << " all joints should be made at startup! jointName = " << jointName <<  endl;
 		//will crash here - so lets make a shared_ptr
-		joints[jointName] = shared_ptr <Joint>(new Joint());
-		joints[jointName]->name = jointName;
+		it = joints.insert(make_pair(jointName, shared_ptr <Joint>(new Joint()))).first;
+		it->second->name = jointName;
+		JointIndex index = getIndexForName(jointName);
+		if (index != TOTAL_JOINTS) jointsByIndex[index] = it->second;
 	}
+	Joint& joint = *it->second;
 
 	scale = ofMap(position.z, 0.f, 4.f, 1000.f, 200.f) * imageScale;
-	joints[jointName]->pos = position * scale + ofVec3f(ofGetWidth() / 2 + offsetX, ofGetHeight() * 3 / 5 + offsetY, 0);
-	joints[jointName]->bSeen = seen;
-	joints[jointName]->bNewThisFrame = true;
+	joint.pos = position * scale + ofVec3f(ofGetWidth() / 2 + offsetX, ofGetHeight() * 3 / 5 + offsetY, 0);
+	joint.bSeen = seen;
+	joint.bNewThisFrame = true;
 
 	if (firstTimeSeen < 0) {
 		firstTimeSeen = lastTimeSeen;
@@ -67,28 +67,42 @@ public:
 	};
 
 	void build();
+	// rebuilds the section lines and melts or restores them
+	void update(float dt);
 	void draw();
 	ofColor getColor();
+	// a copy with its own joints, for stepping apart from this one
+	shared_ptr<Skeleton> clone() const;
 
-	shared_ptr <Joint> getJoint(string jointName);
+	shared_ptr <Joint> getJoint(const string& jointName);
 	shared_ptr<Joint> getJoint(JointIndex aJointIndex);
-	string getNameForIndex(JointIndex aindex);
+	static const string& getNameForIndex(JointIndex aindex);
+	// returns TOTAL_JOINTS for names that aren't joints
+	static JointIndex getIndexForName(const string& aname);
+	// splits an OSC address into the first amaxParts of aparts, reusing their
+	// storage, and returns how many parts there were
+	static int splitAddress(const string& aaddress, string* aparts, int amaxParts);
 	map <string, BodySection > sections;
 	float meltingSpeed = 0.002f;
 	float restoringSpeed = 0.01f;
 	float scale = 0;
 	bool hasSameColor = false;
 
-	void addOrUpdateJoint(string jointName, ofVec3f position, bool seen, float imageScale, int offsetX, int offsetY);
+	void addOrUpdateJoint(const string& jointName, ofVec3f position, bool seen, float imageScale, int offsetX, int offsetY);
 
 	float firstTimeSeen = -1;
 	float lastTimeSeen = 0;
 
-	bool restoring;
+	bool restoring = false;
 	Color color = RED;
 
 protected:
+	// clears aline and adds the joints in order
+	void setLine(ofPolyline& aline, const JointIndex* ajoints, int acount);
+
 	map <string, shared_ptr<Joint> > joints;
+	// the same joints, for lookups by index without a string
+	shared_ptr<Joint> jointsByIndex[TOTAL_JOINTS];
 	ofMesh drawMesh;
 
 
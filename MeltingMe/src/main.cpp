@@ -1,13 +1,50 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "ofAppNoWindow.h"
 
 //========================================================================
-int main( ){
-	ofSetupOpenGL(1920,1080,OF_FULLSCREEN);			// <-------- setup the GL context
+int main(int argc, char *argv[]){
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == "--verify-kernels") {
+			// checks every section kernel backend against ofPolyline and exits, 1 on any mismatch
+			int mismatches = SectionKernel::verify(2000, 1);
+			ofLogNotice("main") << "section kernels up to " << SectionKernel::getBackendName(SectionKernel::getBestBackend()) << ": " << mismatches << " mismatching pixels";
+			return mismatches ? 1 : 0;
+		}
+		if (string(argv[i]) == "--verify-shards") {
+			// a full crowd has to fit the render nodes' receive buffer part by part, exits 1 if it doesn't
+			int failures = ShardFrame::verify();
+			ofLogNotice("main") << ShardFrame::MAX_BODIES << " bodies in " << ShardFrame::MAX_PARTS << " shard parts of up to " << ShardFrame::MAX_PART_BYTES << " bytes: " << failures << " failures";
+			return failures ? 1 : 0;
+		}
+	}
+	ShardConfig shardConfig = ShardConfig::fromArgs(argc, argv);
+	string shardError = shardConfig.getError();
+	if (shardError != "") {
+		ofLogError("main") << shardError;
+		return 1;
+	}
+	ReplayConfig replayConfig = ReplayConfig::fromArgs(argc, argv);
+	BatchedOscConfig batchedOscConfig = BatchedOscConfig::fromArgs(argc, argv);
+	if (replayConfig.bHeadless) {
+		// simulates without a GL context, nothing is drawn
+		ofSetupOpenGL(make_shared<ofAppNoWindow>(), 1920, 1080, OF_WINDOW);
+	}
+	else if (shardConfig.bWindowed) {
+		// lets several nodes run side by side on one machine
+		ofSetupOpenGL(960, 540, OF_WINDOW);
+	}
+	else {
+		ofSetupOpenGL(1920,1080,OF_FULLSCREEN);			// <-------- setup the GL context
+	}
 
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
 	// pass in width and height too:
-	ofRunApp(new ofApp());
+	ofApp* app = new ofApp();
+	app->shardConfig = shardConfig;
+	app->replayConfig = replayConfig;
+	app->batchedOscConfig = batchedOscConfig;
+	ofRunApp(app);
 
 }
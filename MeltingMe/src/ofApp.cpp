@@ -22,17 +22,34 @@ void ofApp::setup() {
 	ofSetFrameRate(60);
 	ofBackground(30);
 
-	bUseLiveOsc = true;
+	bUseLiveOsc = shardConfig.role != ShardConfig::RENDER;
+	if (replayConfig.isReplaying()) {
+		// a replay sees only its recording, with the same random colors every run
+		bUseLiveOsc = false;
+		ofSeedRandom(0);
+		if (replayConfig.bHeadless) ofSetFrameRate(0);
+		ofLogNotice("ofApp") << replayConfig.toString();
+	}
+	wallWidth = ofGetWidth();
+	wallHeight = ofGetHeight();
+	shardLink.setup(shardConfig);
+	ofLogNotice("ofApp") << "shard: " << shardConfig.toString();
+	metrics.setup(9180);
+	bUseLedOutput = ledOutput.setup("led-map.txt");
+	if (bUseLedOutput && ledOutput.getHost() == "127.0.0.1") {
+		bUseLedCheck = ledCheck.setup(ledOutput);
+	}
 	// uncomment to use OSC //
 	if (bUseLiveOsc) {
-		oscRX.setup(12345);
+		bUseFusion = fusion.setup("sensors.txt");
 	}
-
-	ofDirectory tdir;
-	tdir.allowExt("txt");
-	tdir.listDir("recordings");
-	if (tdir.size()) {
-		loadPlaybackData(tdir.getPath(tdir.size() - 1));
+	if (bUseLiveOsc && !bUseFusion) {
+		if (batchedOscConfig.bEnabled) {
+			bUseBatchedUdp = batchedRX.setup(12345, 64, batchedOscConfig.rcvBufBytes);
+		}
+		if (!bUseBatchedUdp) {
+			oscRX.setup(12345);
+		}
 	}
 
 
@@ -40,40 +57,256 @@ void ofApp::setup() {
 	gui.setPosition(ofGetWidth() - 10 - gui.getWidth(), 10);
 	gui.add(bDebug.set("Debug", true));
 	gui.add(bUseRecordedData.set("Use Recorded", false));
+	gui.add(recordingIndex.set("Recording", 0, 0, 0));
+	gui.add(recordingName.set("Recording Name", ""));
+	gui.add(loadProgress.set("Load Progress", 0, 0, 1));
 	gui.add(selfRestore.set("Self Restore", true));
+	gui.add(bPipelined.set("Pipelined", false));
 	gui.add(dripCount.set("Line Count", 0));
+	gui.add(bBlockCoverage.set("Block Coverage", true));
+	gui.add(exactCells.set("Exact Cells", 0));
+	gui.add(frameAllocations.set("Frame Allocs", 0));
+	gui.add(heapViolations.set("Heap Violations", 0));
+	gui.add(bBreakOnAlloc.set("Break On Alloc", false));
 	gui.add(lastft.set("Delta Time", 0));
 	gui.add(fps.set("FPS", 0));
+	if (shardConfig.role == ShardConfig::RENDER) {
+		gui.add(shardFrameNum.set("Shard Frame", 0));
+		gui.add(shardSkipped.set("Shard Skipped", 0));
+	}
+	if (bUseFusion) {
+		gui.add(fusedBodies.set("Fused Bodies", 0));
+		gui.add(sensorDetections.set("Sensor Detections", 0));
+	}
+	if (bUseLedOutput) {
+		gui.add(ledFrames.set("LED Frames", 0));
+	}
+	if (bUseLedCheck) {
+		gui.add(ledIncomplete.set("LED Incomplete", 0));
+		gui.add(ledLatency.set("LED Latency ms", 0));
+	}
+	gui.add(bValidate.set("Validate", replayConfig.bValidate));
+	gui.add(divergentFrames.set("Divergent Frames", 0));
+	if (bUseBatchedUdp) {
+		gui.add(udpPacketsPerSecond.set("UDP Packets/s", 0));
+		gui.add(udpKBytesPerSecond.set("UDP KB/s", 0));
+		gui.add(udpDrops.set("UDP Drops", 0));
+		gui.add(udpTruncated.set("UDP Truncated", 0));
+	}
 	gui.add(numRows.set("Pixels Per Row", 120, 0, 240));
 	gui.add(numCols.set("Pixels Per Column", 90, 0, 180));
 	gui.add(bodyWidth.set("Body Width", 1, 0, 4));
 	gui.add(meltingSpeedBase.set("Melting Speed", 0.1f, 0, 0.5f));
 	gui.add(dropSpeed.set("Drop Speed", 0.8f, 0.5f, 2));
+	gui.add(dripRate.set("Drip Rate", 30, 0, 60));
+	gui.add(dripBudget.set("Drip Budget", 30000, 0, 100000));
+	gui.add(maxDrips.set("Max Drips", 25000, 0, 100000));
+	gui.add(energyRate.set("Energy Rate", 2, 0, 10));
+	gui.add(energyCount.set("Energy Count", 0));
+	gui.add(energyTime.set("Energy ms", 0));
 	gui.add(touchingThresholdBase.set("Touch Thrd", 10, 5, 20));
 	gui.add(imageScale.set("Scale", 1, 0, 4));
 	gui.add(offsetX.set("offsetX", 0, -200, 200));
 	gui.add(offsetY.set("offsetY", 0, -200, 200));
 
 	if (bUseLiveOsc) gui.add(bRecording.set("Recording", false));
+	gui.add(flightMinutes.set("Flight Minutes", 10, 1, 60));
+	flightRecorder.setup(flightMinutes * 60);
+
+	// the newest recording loads in the background while the show starts
+	listRecordings();
+	recordingIndex = max(0, (int)recordingPaths.size() - 1);
+	if (replayConfig.isReplaying()) {
+		recordingLoader.load(replayConfig.path);
+		while (recordingLoader.isLoading()) {
+			ofSleepMillis(10);
+		}
+		if (!recordingLoader.fetch(playbackDataCached) || playbackDataCached.empty()) {
+			ofLogError("ofApp") << "nothing to replay in " << replayConfig.path;
+			ofExit(1);
+		}
+		bUseRecordedData = true;
+		playbackPosition = playbackDataCached.size();
+		recordingName = ofFilePath::getFileName(replayConfig.path);
+		if (replayConfig.renderFolder != "") {
+			bUseOfflineRender = offlineRenderer.setup(replayConfig.renderFolder, OfflineRenderer::getFormatForName(replayConfig.renderFormat),
+				wallWidth, wallHeight, replayConfig.renderThreads);
+		}
+	}
 
-	for (int i = 0; i<numRows; i++) {
-		for (int j = 0; j<numCols; j++) {
-			Pixel p;
-			ofRectangle r;
-			r.width = ofGetWidth() / numRows - 2;
-			r.height = ofGetHeight() / numCols - 2;
-			r.x = ofGetWidth() / numRows*i + 1;
-			r.y = ofGetHeight() / numCols*j + 1;
-			p.rect = r;
-			pixels.push_back(p);
+	ofLogNotice("ofApp") << "section kernel: " << SectionKernel::getBackendName(SectionKernel::getBackend());
+	// DualRun's reference is ofPolyline, which the kernels only match bit for
+	// bit when the build doesn't contract floats into fused multiply adds;
+	// anywhere else validating would flag frames that are correct
+	int kernelMismatches = SectionKernel::verify(50, 1);
+	bKernelsExact = kernelMismatches == 0;
+	if (!bKernelsExact) {
+		ofLogError("ofApp") << "section kernels disagree with ofPolyline on " << kernelMismatches << " pixels in this build, validation is off";
+		bValidate = false;
+		if (replayConfig.bValidate) {
+			ofExit(2);
 		}
 	}
+
+	buildPixels();
+	energies.setup(4000);
 }
 
 //--------------------------------------------------------------
 void ofApp::update() {
 
 	float etimef = ofGetElapsedTimef();
+	float dt = ofGetLastFrameTime();
+	metrics.recordFrame(dt);
+	divergentFrames = dualRun.getNumDivergentFrames();
+	if (bValidate && !bKernelsExact) {
+		bValidate = false;
+	}
+
+	if (replayConfig.isReplaying()) {
+		if (bReplayFinished) return;
+		// fixed steps, so the frames don't depend on how fast this machine runs
+		dt = 1 / replayConfig.fps;
+		etimef = replayFrame * dt;
+		// the replay ends on the frame that plays its last message
+		bPipelined = false;
+	}
+
+	if (!replayConfig.isReplaying() && recordingIndex != loadedRecordingIndex && recordingIndex < recordingPaths.size() && !recordingLoader.isLoading()) {
+		loadPlaybackData(recordingPaths[recordingIndex]);
+		loadedRecordingIndex = recordingIndex;
+		recordingName = recordingNames[recordingIndex];
+	}
+	if (recordingArchiver.fetchFinished()) {
+		listRecordings();
+	}
+
+	// archives arrive a batch at a time, playback starts on the first one
+	// and only wraps around once the last one is in
+	bool bLoading = recordingLoader.isLoading();
+	loadProgress = bLoading ? recordingLoader.getProgress() : 1;
+	pipeline.lock();
+	bool bReplaced = false;
+	if (recordingLoader.fetch(playbackDataCached, &bReplaced) && bReplaced) {
+		bRestartPlayback = true;
+	}
+	bPlaybackComplete = !bLoading;
+	pipeline.unlock();
+	if (bUseRecordedData && playbackDataCached.empty() && !bLoading) {
+		bUseRecordedData = false;
+	}
+
+	if (shardConfig.role == ShardConfig::RENDER) {
+		readSettings(settings);
+		// every frame is stepped, so this node has simulated as much time as its neighbours
+		while (shardLink.receive(shardFrame)) {
+			simulateShard(shardFrame);
+		}
+		dripCount = drips.size();
+		energyCount = energies.size();
+		energyTime = energyMillis;
+		exactCells = blockStats.exactCells;
+		shardFrameNum = shardLink.lastFrameNum;
+		shardSkipped = shardLink.numSkippedFrames;
+		updateLedStats();
+		lastft = dt;
+		fps = ofGetFrameRate();
+		return;
+	}
+
+	// pipelining buys a whole frame of simulation time at the cost of a frame of latency
+	if (bPipelined && !pipeline.isThreadRunning()) {
+		pipeline.start([this](float atime, float adt, const FrameSettings& asettings, FrameSnapshot& asnapshot) {
+			settings = asettings;
+			simulate(atime, adt);
+			fillSnapshot(asnapshot);
+		});
+	}
+	else if (!bPipelined && pipeline.isThreadRunning()) {
+		pipeline.stop();
+	}
+
+	if (pipeline.isThreadRunning()) {
+		FrameSettings tsettings;
+		readSettings(tsettings);
+		pipeline.requestStep(etimef, dt, tsettings);
+	}
+	else {
+		readSettings(settings);
+		simulate(etimef, dt);
+		dripCount = drips.size();
+		energyCount = energies.size();
+		energyTime = energyMillis;
+		exactCells = blockStats.exactCells;
+		if (replayConfig.isReplaying()) {
+			if (bUseOfflineRender) {
+				FrameSnapshot& snapshot = offlineRenderer.acquire();
+				fillSnapshot(snapshot);
+				snapshot.frameNum = replayFrame;
+				offlineRenderer.submit();
+			}
+			replayFrame++;
+			if (playbackPosition >= playbackDataCached.size()) {
+				finishReplay();
+			}
+		}
+	}
+
+	lastft = dt;
+	fps = ofGetFrameRate();
+	updateLedStats();
+	frameAllocations = metrics.getLastAllocations(Metrics::STAGE_SIMULATE);
+	heapViolations = HeapTracker::getViolations();
+	if (bUseFusion) {
+		fusedBodies = fusion.getNumFusedBodies();
+		sensorDetections = fusion.getNumDetections();
+		uint64_t fusionErrors = fusion.getNumParseErrors();
+		metrics.count(Metrics::COUNTER_PARSE_ERRORS, fusionErrors - lastFusionErrors);
+		lastFusionErrors = fusionErrors;
+	}
+	if (bUseBatchedUdp) {
+		udpPacketsPerSecond = batchedRX.getPacketsPerSecond();
+		udpKBytesPerSecond = batchedRX.getBytesPerSecond() / 1024;
+		udpDrops = batchedRX.getKernelDrops();
+		metrics.setCounter(Metrics::COUNTER_UDP_DROPS, batchedRX.getKernelDrops());
+		udpTruncated = batchedRX.getTruncatedPackets();
+		metrics.setCounter(Metrics::COUNTER_UDP_TRUNCATED, batchedRX.getTruncatedPackets());
+		uint64_t packetErrors = batchedRX.getParseErrors();
+		metrics.count(Metrics::COUNTER_PARSE_ERRORS, packetErrors - lastPacketErrors);
+		lastPacketErrors = packetErrors;
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::finishReplay() {
+	bReplayFinished = true;
+	ofLogNotice("ofApp") << "replayed " << replayConfig.path << " in " << replayFrame << " frames";
+	if (bUseOfflineRender) {
+		offlineRenderer.close();
+	}
+	if (bValidate) {
+		ofLogNotice("ofApp") << dualRun.getSummary();
+	}
+	ofExit(dualRun.getNumDivergentFrames() ? 1 : 0);
+}
+
+//--------------------------------------------------------------
+void ofApp::exit() {
+	pipeline.stop();
+	batchedRX.close();
+	fusion.close();
+	ledOutput.close();
+	ledCheck.close();
+	offlineRenderer.close();
+	metrics.close();
+}
+
+//--------------------------------------------------------------
+void ofApp::simulate(float etimef, float dt) {
+	Metrics::Mark simulateStart = metrics.mark();
+	simTime = etimef;
+	simFrame++;
+	cellFrame = simFrame;
 
 	//change color every 10 seconds
 	if (etimef - lastColorChangeTime > 10) {
@@ -91,17 +324,26 @@ void ofApp::update() {
 
 
 	if (bUseLiveOsc) {
-		while (oscRX.hasWaitingMessages()) {
-			ofxOscMessage msg;
-			oscRX.getNextMessage(msg);
+		if (bUseFusion) {
+			fusion.update(etimef);
+		}
+		ofxOscMessage msg;
+		while (getNextLiveMessage(msg)) {
 
-			parseMessage(msg);
+			if (msg.getAddress() == "/melting/dump") {
+				flightRecorder.dump();
+				continue;
+			}
+
+			metrics.count(Metrics::COUNTER_OSC_MESSAGES);
+			parseMessage(msg, true);
 
-			if (bRecording) {
+			if (settings.bRecording) {
 				if (uniqueFilename == "") {
 					uniqueFilename = ofGetTimestampString();
 					startRecordingTime = etimef;
 					recordingData.clear();
+					recordingData.reserve(1 << 16);
 				}
 			}
 			else {
@@ -114,37 +356,26 @@ void ofApp::update() {
 				uniqueFilename = "";
 			}
 
-			if (bRecording) {
-				SkeletonData sdata;
-				sdata.time = etimef - startRecordingTime;
-				sdata.message = msg;
-				recordingData.push_back(sdata);
+			if (settings.bRecording) {
+				recordingData.push_back(SkeletonData());
+				recordingData.back().time = etimef - startRecordingTime;
+				recordingData.back().message = msg;
 			}
 
 		}
 	}
-	if (bUseRecordedData) {
-		if (playbackData.size() == 0 && playbackDataCached.size()) {
-			playbackData = playbackDataCached;
+	if (settings.bUseRecordedData) {
+		// plays straight out of the cached recording, starting over once all of it has played
+		if (bRestartPlayback || (playbackPosition >= playbackDataCached.size() && bPlaybackComplete && playbackDataCached.size())) {
+			playbackPosition = 0;
 			playbackTimeStart = etimef;
+			bRestartPlayback = false;
 		}
 
-		if (playbackData.size()) {
-			float playEndTime = playbackTimeStart + playbackData.back().time;
-			float timeSinceStart = etimef - playbackTimeStart;
-			int numToKill = 0;
-			for (int k = 0; k < playbackData.size(); k++) {
-				if (playbackData[k].time <= timeSinceStart) {
-					parseMessage(playbackData[k].message);
-					numToKill++;
-				}
-				else {
-					break;
-				}
-			}
-			if (numToKill > 0) {
-				playbackData.erase(playbackData.begin(), playbackData.begin() + numToKill);
-			}
+		float timeSinceStart = etimef - playbackTimeStart;
+		while (playbackPosition < playbackDataCached.size() && playbackDataCached[playbackPosition].time <= timeSinceStart) {
+			parseMessage(playbackDataCached[playbackPosition].message);
+			playbackPosition++;
 		}
 
 
@@ -154,84 +385,308 @@ void ofApp::update() {
 	for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
 		if (etimef - it->second->lastTimeSeen > 2.0) {
 			skeletons.erase(it);
+			metrics.count(Metrics::COUNTER_EVICTIONS);
 			break;
 		}
 	}
 
 	//    cout << "Number of skeletons : " << skeletons.size() << " | " << ofGetFrameNum() << endl;
 
-	updatePixels();
+	if (settings.bValidate) {
+		dualRun.begin(pixels, skeletons);
+	}
+
+	Metrics::Mark stageStart = metrics.endStage(Metrics::STAGE_INGEST, simulateStart);
 
-	dripCount = drips.size();
-	lastft = ofGetLastFrameTime();
-	fps = ofGetFrameRate();
+	// new bodies, a new grid or a new drip cap grow the buffers, after that
+	// the rest of the frame should run out of the storage it already has
+	if (skeletons.size() != lastNumSkeletons || settings.maxDrips != lastMaxDrips) {
+		lastNumSkeletons = skeletons.size();
+		lastMaxDrips = settings.maxDrips;
+		steadyFrames = 0;
+	}
+	else {
+		steadyFrames++;
+	}
+	uint64_t violations = HeapTracker::getViolations();
+	HeapTracker::setBreakOnViolation(settings.bBreakOnAlloc);
+	{
+		HeapTracker::NoAllocScope steadyScope(steadyFrames >= WARM_UP_FRAMES && !settings.bValidate);
+
+		updatePixels(dt);
+		stageStart = metrics.endStage(Metrics::STAGE_PIXELS, stageStart);
+
+		updateDrips(dt);
+		stageStart = metrics.endStage(Metrics::STAGE_DRIPS, stageStart);
+
+		detectTouching(dt);
+		stageStart = metrics.endStage(Metrics::STAGE_TOUCHING, stageStart);
+
+		updateEnergies(dt);
+		stageStart = metrics.endStage(Metrics::STAGE_ENERGIES, stageStart);
+
+		for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
+			it->second->update(dt);
+		}
+		stageStart = metrics.endStage(Metrics::STAGE_MELT, stageStart);
 
+		if (settings.bValidate) {
+			dualRun.runReference(dt, settings.bodyWidth, settings.meltingSpeedBase, settings.touchingThresholdBase);
+			dualRun.compare(simFrame, pixels, skeletons);
+			stageStart = metrics.mark();
+		}
+
+		if (bUseLedOutput) {
+			ledOutput.pack(pixels);
+			metrics.endStage(Metrics::STAGE_LED, stageStart);
+		}
+	}
+	if (HeapTracker::getViolations() != violations) {
+		reportHeapViolation();
+	}
+
+	if (shardConfig.role == ShardConfig::INGEST) {
+		shardFrame.frameNum++;
+		shardFrame.time = etimef;
+		shardFrame.dt = dt;
+		shardFrame.wallWidth = wallWidth;
+		shardFrame.wallHeight = wallHeight;
+		shardFrame.numRows = settings.numRows;
+		shardFrame.numCols = settings.numCols;
+		shardFrame.dripAcceptRatio = dripEmitter.acceptRatio;
+		shardFrame.fromSkeletons(skeletons);
+		shardLink.send(shardFrame);
+	}
+
+	setMetricGauges();
+	metrics.endStage(Metrics::STAGE_SIMULATE, simulateStart);
+}
+
+//--------------------------------------------------------------
+void ofApp::updateLedStats() {
+	if (bUseLedOutput) {
+		ledFrames = ledOutput.getFramesSent();
+	}
+	if (bUseLedCheck) {
+		ledIncomplete = ledCheck.getIncompleteFrames();
+		ledLatency = ledCheck.getLatencyMillis();
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::setMetricGauges() {
+	metrics.setGauge(Metrics::GAUGE_SKELETONS, skeletons.size());
+	metrics.setGauge(Metrics::GAUGE_DRIPS, drips.size());
+	metrics.setGauge(Metrics::GAUGE_ENERGIES, energies.size());
+	metrics.setGauge(Metrics::GAUGE_PIXELS, pixels.size());
+	metrics.setGauge(Metrics::GAUGE_EXACT_CELLS, blockStats.exactCells);
+}
+
+//--------------------------------------------------------------
+void ofApp::updateDrips(float dt) {
 	for (int i = 0; i<drips.size(); i++) {
-		drips[i].update(dropSpeed);
+		drips[i].update(settings.dropSpeed, dt);
 	}
 
 	ofRemove(drips, shouldRemoveDrip);
+}
+
+//--------------------------------------------------------------
+void ofApp::simulateShard(const ShardFrame& aframe) {
+	// the grid has to line up with the ingest node's for the seams to match
+	if (aframe.wallWidth != wallWidth || aframe.wallHeight != wallHeight || aframe.numRows != numRows || aframe.numCols != numCols) {
+		wallWidth = aframe.wallWidth;
+		wallHeight = aframe.wallHeight;
+		numRows = aframe.numRows;
+		numCols = aframe.numCols;
+		buildPixels();
+	}
+
+	// melting and touching already happened on the ingest node
+	Metrics::Mark simulateStart = metrics.mark();
+	cellFrame = aframe.frameNum;
+	dripEmitter.sharedAcceptRatio = aframe.dripAcceptRatio;
+	aframe.toSkeletons(skeletons);
+	Metrics::Mark stageStart = metrics.endStage(Metrics::STAGE_INGEST, simulateStart);
+	updatePixels(aframe.dt);
+	stageStart = metrics.endStage(Metrics::STAGE_PIXELS, stageStart);
+	updateDrips(aframe.dt);
+	stageStart = metrics.endStage(Metrics::STAGE_DRIPS, stageStart);
+	updateEnergies(aframe.dt);
+	stageStart = metrics.endStage(Metrics::STAGE_ENERGIES, stageStart);
+
+	if (bUseLedOutput) {
+		ledOutput.pack(pixels);
+		metrics.endStage(Metrics::STAGE_LED, stageStart);
+	}
 
-	detectTouching();
+	setMetricGauges();
+	metrics.endStage(Metrics::STAGE_SIMULATE, simulateStart);
 }
 
 //--------------------------------------------------------------
-void ofApp::detectTouching() {
+ofRectangle ofApp::getShardRegion() {
+	if (shardConfig.role != ShardConfig::RENDER || numRows <= 0 || numCols <= 0) {
+		return ofRectangle(0, 0, wallWidth, wallHeight);
+	}
+	float cellWidth = wallWidth / numRows;
+	float cellHeight = wallHeight / numCols;
+	return ofRectangle(shardConfig.regionX0 * cellWidth, shardConfig.regionY0 * cellHeight,
+		(shardConfig.regionX1 - shardConfig.regionX0) * cellWidth, (shardConfig.regionY1 - shardConfig.regionY0) * cellHeight);
+}
+
+//--------------------------------------------------------------
+void ofApp::updateEnergies(float dt) {
+	uint64_t startMicros = ofGetElapsedTimeMicros();
+
+	energyTargets.clear();
+	energyTargets.reserve(skeletons.size() * 2);
 	for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
-		it->second->restoring = false;
-		it->second->meltingSpeed = ofGetLastFrameTime() * meltingSpeedBase;
-		it->second->hasSameColor = false;
-		for (auto jt = skeletons.begin(); jt != skeletons.end(); jt++) {
-			if (it != jt && it->second->color == jt->second->color) {
-				it->second->hasSameColor = true;
+		if (it->second->restoring) {
+			energyTargets.push_back(ofVec2f(it->second->getJoint(Skeleton::HAND_LEFT)->pos));
+			energyTargets.push_back(ofVec2f(it->second->getJoint(Skeleton::HAND_RIGHT)->pos));
+		}
+	}
+
+	if (energyTargets.size()) {
+		float chance = settings.energyRate * dt;
+		for (int i = 0; i < pixels.size(); i++) {
+			if (pixels[i].isRestoring && pixels[i].getCellRandom(cellFrame, Pixel::RANDOM_ENERGY) < chance) {
+				energies.spawn(ofVec2f(pixelCentersX[i], pixelCentersY[i]));
 			}
 		}
 	}
 
+	energies.update(dt, energyTargets);
+	energies.buildMesh();
+
+	energyMillis = (ofGetElapsedTimeMicros() - startMicros) / 1000.f;
+}
+
+//--------------------------------------------------------------
+void ofApp::fillSnapshot(FrameSnapshot& asnapshot) {
+	// assigning into the old snapshot reuses its storage
+	asnapshot.pixels = pixels;
+	asnapshot.drips = drips;
+	asnapshot.energyMesh = energies.mesh;
+	asnapshot.numEnergies = energies.size();
+	asnapshot.energyMillis = energyMillis;
+	asnapshot.numExactCells = blockStats.exactCells;
+	asnapshot.skeletons.resize(skeletons.size());
+	int b = 0;
+	for (auto it = skeletons.begin(); it != skeletons.end(); it++, b++) {
+		asnapshot.skeletons[b].set(*it->second);
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::readSettings(FrameSettings& asettings) {
+	asettings.bRecording = bRecording;
+	asettings.bUseRecordedData = bUseRecordedData;
+	asettings.bValidate = bValidate;
+	asettings.bBlockCoverage = bBlockCoverage;
+	asettings.bBreakOnAlloc = bBreakOnAlloc;
+	asettings.numRows = numRows;
+	asettings.numCols = numCols;
+	asettings.bodyWidth = bodyWidth;
+	asettings.meltingSpeedBase = meltingSpeedBase;
+	asettings.touchingThresholdBase = touchingThresholdBase;
+	asettings.dropSpeed = dropSpeed;
+	asettings.dripRate = dripRate;
+	asettings.dripBudget = dripBudget;
+	asettings.maxDrips = maxDrips;
+	asettings.energyRate = energyRate;
+	asettings.imageScale = imageScale;
+	asettings.offsetX = offsetX;
+	asettings.offsetY = offsetY;
+}
+
+//--------------------------------------------------------------
+void ofApp::detectTouching(float dt) {
+	// same rules as DualRun::detectTouchingReference(), with each body's hands looked up once
+	touchBodies.clear();
+	touchHands.clear();
 	for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
-		touchingThreshold = it->second->scale / touchingThresholdBase;
-		for (auto jt = skeletons.begin(); jt != skeletons.end(); jt++) {
-			if (it != jt) {
-				if (it->second->getJoint("HandLeft")->pos.distance(jt->second->getJoint("HandLeft")->pos) < touchingThreshold
-					|| it->second->getJoint("HandRight")->pos.distance(jt->second->getJoint("HandRight")->pos) < touchingThreshold
-					|| it->second->getJoint("HandLeft")->pos.distance(jt->second->getJoint("HandRight")->pos) < touchingThreshold
-					|| it->second->getJoint("HandRight")->pos.distance(jt->second->getJoint("HandLeft")->pos) < touchingThreshold) {
-					if (it->second->color == jt->second->color) {
-						it->second->restoring = true;
-						jt->second->restoring = true;
-					}
-					else {
-						it->second->meltingSpeed = ofGetLastFrameTime() * meltingSpeedBase * 4;
-						jt->second->meltingSpeed = ofGetLastFrameTime() * meltingSpeedBase * 4;
-					}
+		Skeleton* s = it->second.get();
+		s->restoring = false;
+		s->meltingSpeed = dt * settings.meltingSpeedBase;
+		s->hasSameColor = false;
+		touchBodies.push_back(s);
+		touchHands.push_back(make_pair(s->getJoint(Skeleton::HAND_LEFT)->pos, s->getJoint(Skeleton::HAND_RIGHT)->pos));
+	}
+
+	int numBodies = touchBodies.size();
+	for (int i = 0; i < numBodies; i++) {
+		for (int j = 0; j < numBodies; j++) {
+			if (i != j && touchBodies[i]->color == touchBodies[j]->color) {
+				touchBodies[i]->hasSameColor = true;
+			}
+		}
+	}
+
+	for (int i = 0; i < numBodies; i++) {
+		Skeleton* a = touchBodies[i];
+		const ofVec3f& leftA = touchHands[i].first;
+		const ofVec3f& rightA = touchHands[i].second;
+		touchingThreshold = a->scale / settings.touchingThresholdBase;
+		for (int j = 0; j < numBodies; j++) {
+			if (i == j) continue;
+			Skeleton* b = touchBodies[j];
+			const ofVec3f& leftB = touchHands[j].first;
+			const ofVec3f& rightB = touchHands[j].second;
+			if (leftA.distance(leftB) < touchingThreshold
+				|| rightA.distance(rightB) < touchingThreshold
+				|| leftA.distance(rightB) < touchingThreshold
+				|| rightA.distance(leftB) < touchingThreshold) {
+				if (a->color == b->color) {
+					a->restoring = true;
+					b->restoring = true;
+				}
+				else {
+					a->meltingSpeed = dt * settings.meltingSpeedBase * 4;
+					b->meltingSpeed = dt * settings.meltingSpeedBase * 4;
 				}
 			}
 		}
-		if (it->second->getJoint("HandRight")->pos.distance(it->second->getJoint("HandLeft")->pos) < touchingThreshold) {
-			if (it->second->hasSameColor)
-				it->second->meltingSpeed = ofGetLastFrameTime() * meltingSpeedBase * 4;
+		if (rightA.distance(leftA) < touchingThreshold) {
+			if (a->hasSameColor)
+				a->meltingSpeed = dt * settings.meltingSpeedBase * 4;
 			else
-				it->second->restoring = true;
+				a->restoring = true;
 		}
 	}
 }
 
 //--------------------------------------------------------------
-void ofApp::parseMessage(ofxOscMessage amsg) {
+bool ofApp::getNextLiveMessage(ofxOscMessage& amsg) {
+	if (bUseFusion) {
+		return fusion.getNextMessage(amsg);
+	}
+	if (bUseBatchedUdp) {
+		return batchedRX.getNextMessage(amsg);
+	}
+	if (oscRX.hasWaitingMessages()) {
+		return oscRX.getNextMessage(amsg);
+	}
+	return false;
+}
 
-	//    cout << "msg: " << amsg.getAddress() << " | " << ofGetFrameNum() << endl;
+//--------------------------------------------------------------
+void ofApp::parseMessage(const ofxOscMessage& amsg, bool bLive) {
 
-	string address = amsg.getAddress();
-	if (address.size() > 0 && address[0] == '/') {
-		address = address.substr(1, address.size() - 1);
-	}
-	vector< string > parts = split(address, '/');
+	//    cout << "msg: " << amsg.getAddress() << " | " << ofGetFrameNum() << endl;
 
-	if (parts.size() >= 4) {
-		string bodyId = parts[1];
-		string typeName = parts[2];
+	if (Skeleton::splitAddress(amsg.getAddress(), addressParts, 4) >= 4) {
+		const string& bodyId = addressParts[1];
+		const string& typeName = addressParts[2];
 		if (typeName == "joints") {
 
+			if (amsg.getNumArgs() < 4 || amsg.getArgType(0) != OFXOSC_TYPE_FLOAT || amsg.getArgType(1) != OFXOSC_TYPE_FLOAT
+				|| amsg.getArgType(2) != OFXOSC_TYPE_FLOAT || amsg.getArgType(3) != OFXOSC_TYPE_STRING) {
+				metrics.count(Metrics::COUNTER_PARSE_ERRORS);
+				return;
+			}
+
 			ofVec3f tpos;
 			tpos.x = amsg.getArgAsFloat(0);
 			tpos.y = -amsg.getArgAsFloat(1);
@@ -241,13 +696,20 @@ void ofApp::parseMessage(ofxOscMessage amsg) {
 			string status = amsg.getArgAsString(3);
 			bool bSeen = (status != "NotTracked" && status != "Unknown");
 
-			string jointName = parts[3];
+			const string& jointName = addressParts[3];
+
+			if (bLive) {
+				flightRecorder.record(ofGetElapsedTimef(), bodyId, Skeleton::getIndexForName(jointName), amsg.getArgAsFloat(0), amsg.getArgAsFloat(1), amsg.getArgAsFloat(2), status);
+			}
 
-			if (!skeletons.count(bodyId)) {
-				skeletons[bodyId] = shared_ptr<Skeleton>(new Skeleton());
-				skeletons[bodyId]->build();
+			auto body = skeletons.find(bodyId);
+			if (body == skeletons.end()) {
+				body = skeletons.insert(make_pair(bodyId, shared_ptr<Skeleton>(new Skeleton()))).first;
+				body->second->build();
 			}
-			skeletons[bodyId]->addOrUpdateJoint(jointName, tpos, bSeen, imageScale, offsetX, offsetY);
+			body->second->addOrUpdateJoint(jointName, tpos, bSeen, settings.imageScale, settings.offsetX, settings.offsetY);
+			// evicted against the frame's time, which a replay steps without the clock
+			body->second->lastTimeSeen = simTime;
 		}
 
 
@@ -278,110 +740,169 @@ void ofApp::parseMessage(ofxOscMessage amsg) {
 
 //--------------------------------------------------------------
 void ofApp::draw() {
+	if (replayConfig.bHeadless) return;
+
+	// a render node stretches its region over the whole window
+	ofRectangle region = getShardRegion();
+	ofPushMatrix();
+	ofScale(ofGetWidth() / region.width, ofGetHeight() / region.height);
+	ofTranslate(-region.x, -region.y);
+
+	if (pipeline.isThreadRunning()) {
+		const FrameSnapshot& snapshot = pipeline.acquire();
+		dripCount = snapshot.drips.size();
+		energyCount = snapshot.numEnergies;
+		energyTime = snapshot.energyMillis;
+		exactCells = snapshot.numExactCells;
+
+		ofSetColor(120);
+		for (int i = 0; i < snapshot.skeletons.size(); i++) {
+			snapshot.skeletons[i].draw();
+		}
 
-	ofSetColor(120);
-	for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
-		it->second->draw();
-	}
+		for (int i = 0; i < snapshot.pixels.size(); i++) {
+			snapshot.pixels[i].draw();
+		}
 
-	for (int i = 0; i < pixels.size(); i++) {
-		pixels[i].draw();
+		for (int i = 0; i < snapshot.drips.size(); i++) {
+			snapshot.drips[i].draw();
+		}
+
+		snapshot.energyMesh.draw();
 	}
+	else {
+		ofSetColor(120);
+		for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
+			it->second->draw();
+		}
 
-	for (int i = 0; i<drips.size(); i++) {
-		drips[i].draw();
+		for (int i = 0; i < pixels.size(); i++) {
+			pixels[i].draw();
+		}
+
+		for (int i = 0; i<drips.size(); i++) {
+			drips[i].draw();
+		}
+
+		energies.draw();
 	}
 
+	ofPopMatrix();
+
 
 	if (!bHide) {
 		gui.draw();
+
+		ofSetColor(255);
+		float listY = gui.getPosition().y + gui.getHeight() + 20;
+		for (int i = 0; i < recordingNames.size(); i++) {
+			ofDrawBitmapString((i == recordingIndex ? "> " : "  ") + recordingNames[i], gui.getPosition().x, listY + i * 14);
+		}
 	}
 }
 
-void ofApp::updatePixels() {
-	for (int i = 0; i<pixels.size(); i++) {
-		pixels[i].isLitUp = false;
-		pixels[i].isMelting = false;
-		pixels[i].isRestoring = false;
-		pixels[i].preScale = 0;
+//--------------------------------------------------------------
+void ofApp::buildPixels() {
+	steadyFrames = 0;
+	pixels.clear();
+	pixelCentersX.clear();
+	pixelCentersY.clear();
+	int i0 = 0, i1 = numRows, j1 = numCols;
+	if (shardConfig.role == ShardConfig::RENDER) {
+		// drips only fall, so the cells above the region are simulated too
+		i0 = max(0, shardConfig.regionX0);
+		i1 = min((int)numRows, shardConfig.regionX1);
+		j1 = min((int)numCols, shardConfig.regionY1);
 	}
-
-	for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
-		for (auto line = it->second->sections.begin(); line != it->second->sections.end(); line++) {
-			float sectionWidth = 0.05f * it->second->scale * pow(line->second.percentLeft, 1 / 4.f) * bodyWidth;
-			if (line->first == "Spine") sectionWidth *= 2;
-			if (line->second.percentLeft < 0.95f) {
-				for (int i = 0; i < pixels.size(); i++) {
-					if (it->second->scale >= pixels[i].preScale && line->second.meltedPoint.distance(pixels[i].rect.getCenter())<sectionWidth) {
-						pixels[i].color = it->second->getColor();
-						pixels[i].preScale = it->second->scale;
-						if (it->second->restoring)
-							pixels[i].isRestoring = true;
-						else {
-							if (!((line->first == "LeftLeg" || line->first == "RightLeg" || line->first == "RightArm" || line->first == "LeftArm") && line->second.percentLeft <= 0.05f))
-								pixels[i].isMelting = true;
-						}
-					}
-				}
-			}
-			for (int i = 0; i < pixels.size(); i++) {
-				if (it->second->scale >= pixels[i].preScale && line->second.line.getClosestPoint(pixels[i].rect.getCenter()).distance(pixels[i].rect.getCenter()) < sectionWidth) {
-					pixels[i].color = it->second->getColor();
-					pixels[i].isRestoring = false;
-					pixels[i].isMelting = false;
-					pixels[i].isLitUp = true;
-					pixels[i].a = ofMap(it->second->scale, 400, 200, 255, 180);
-					pixels[i].preScale = it->second->scale;
-				}
-			}
+	for (int i = i0; i<i1; i++) {
+		for (int j = 0; j<j1; j++) {
+			Pixel p;
+			ofRectangle r;
+			r.width = wallWidth / numRows - 2;
+			r.height = wallHeight / numCols - 2;
+			r.x = wallWidth / numRows*i + 1;
+			r.y = wallHeight / numCols*j + 1;
+			p.rect = r;
+			// hashed rather than random so every shard starts a cell at the same phase
+			p.cellHash = ((unsigned int)i * 73856093u) ^ ((unsigned int)j * 19349663u);
+			p.dripPhase = p.cellHash % 1000 / 1000.f;
+			pixels.push_back(p);
+			pixelCentersX.push_back(r.getCenter().x);
+			pixelCentersY.push_back(r.getCenter().y);
 		}
 	}
+	pixelsInside.assign(pixels.size(), 0);
+	pixelColumnStart = i0;
+	pixelColumnEnd = i1;
+	pixelRowEnd = j1;
+	if (pixels.size()) {
+		pixelBlocks.build(&pixelCentersX[0], &pixelCentersY[0], i1 - i0, j1);
+	}
+	else {
+		pixelBlocks = SectionKernel::BlockGrid();
+	}
 
-	for (int i = 0; i<pixels.size(); i++) {
-		pixels[i].update();
-		if (pixels[i].isMelting && (int)(ofGetElapsedTimef() * 10) % 2 == 0) {
-			drips.push_back(pixels[i].createDrip(pixels[i].color));
-		}
-		if (pixels[i].isRestoring) {
-			pixels[i].a = 255;
-			pixels[i].color = pixels[i].color.lerp(ofColor(255), 0.5f);
-		}
+	const GridKernels::Kernels& kernels = GridKernels::getKernels(numRows, numCols, pixels.size());
+	if (gridKernels != &kernels) {
+		ofLogNotice("ofApp") << "grid kernels: " << kernels.name;
 	}
-}
+	gridKernels = &kernels;
 
-void Pixel::update() {
-	a -= 50;
-	if (a<0)a = 0;
-	/*if (isLitUp) {
-	a = 255;
-	}*/
+	if (bUseLedOutput) {
+		ledOutput.resolve([this](int ax, int ay) { return getPixelIndex(ax, ay); });
+	}
 }
 
-void Pixel::draw() {
-	ofSetColor(color, a);
-	ofDrawRectangle(rect);
+//--------------------------------------------------------------
+int ofApp::getPixelIndex(int ax, int ay) {
+	if (ax < pixelColumnStart || ax >= pixelColumnEnd || ay < 0 || ay >= pixelRowEnd) {
+		return -1;
+	}
+	return (ax - pixelColumnStart) * pixelRowEnd + ay;
 }
 
-Drip Pixel::createDrip(ofColor c) {
-	Drip d;
-	d.rect = rect;
-	d.color = d.color.lerp(c, 0.3f);
-	return d;
-}
+void ofApp::updatePixels(float dt) {
+	if (pixels.empty()) return;
+	const GridKernels::Kernels& kernels = *gridKernels;
+	int count = pixels.size();
+
+	kernels.reset(&pixels[0], count);
+	blockStats = SectionKernel::BlockStats();
 
-void Drip::update(float speed) {
-	vel += ofGetLastFrameTime() * speed;
-	rect.position.y += vel;
-	a -= ofGetLastFrameTime() * 300;
-	if (a<0) {
-		a = 0;
-		bRemove = true;
+	for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
+		for (auto line = it->second->sections.begin(); line != it->second->sections.end(); line++) {
+			GridKernels::SectionType type = GridKernels::getSectionType(line->first);
+			if (type == GridKernels::TOTAL_SECTIONS) continue;
+
+			GridKernels::SectionInput section;
+			section.meltedPoint = line->second.meltedPoint;
+			section.percentLeft = line->second.percentLeft;
+			section.width = 0.05f * it->second->scale * pow(line->second.percentLeft, 1 / 4.f) * settings.bodyWidth * GridKernels::getWidthMultiplier(type);
+			section.scale = it->second->scale;
+			section.color = it->second->getColor();
+			section.alpha = ofMap(it->second->scale, 400, 200, 255, 180);
+			section.bRestoring = it->second->restoring;
+			section.inside = &pixelsInside[0];
+
+			if (settings.bBlockCoverage) {
+				SectionKernel::classifyBlocks(line->second.line, pixelBlocks, &pixelCentersX[0], &pixelCentersY[0], section.width, &pixelsInside[0], &blockStats);
+			}
+			else {
+				SectionKernel::classify(line->second.line, &pixelCentersX[0], &pixelCentersY[0], count, section.width, &pixelsInside[0]);
+				blockStats.exactCells += count;
+			}
+			kernels.sections[type](&pixels[0], &pixelCentersX[0], &pixelCentersY[0], count, section);
+		}
 	}
-}
 
-void Drip::draw() {
-	ofSetColor(color, a);
-	ofDrawRectangle(rect);
+	kernels.decay(&pixels[0], count);
+
+	dripEmitter.ratePerPixel = settings.dripRate;
+	dripEmitter.budgetPerSecond = settings.dripBudget;
+	dripEmitter.maxDrips = settings.maxDrips;
+	dripEmitter.emit(pixels, drips, dt, cellFrame, kernels);
+
+	kernels.restore(&pixels[0], count);
 }
 
 //--------------------------------------------------------------
@@ -421,52 +942,46 @@ void ofApp::saveRecording() {
 
 //--------------------------------------------------------------
 void ofApp::loadPlaybackData(string afilePath) {
-	playbackDataCached.clear();
-
-	ofBuffer tbuffer = ofBufferFromFile(afilePath);
-	if (tbuffer.size()) {
-		for (auto a : tbuffer.getLines()) {
-			string lineStr = a;
-			ofStringReplace(lineStr, "\n", "");
-			vector <string> results = split(lineStr, '|');
-
-			if (results.size() >= 5) {
-				SkeletonData sdata;
-				sdata.time = ofToFloat(results[0]);
-				sdata.message.setAddress(results[1]);
-				// now set the params //
-				for (int k = 2; k < results.size(); k++) {
-					if (results[k] == "") continue;
-					if (results[k].length() <= 1) continue;
-					string vstring = results[k];
-					vstring = vstring.substr(1, vstring.length());
-					if (results[k][0] == 'f') {
-						// float
-						sdata.message.addFloatArg(ofToFloat(vstring));
-					}
-					else if (results[k][0] == 's') {
-						// string //
-						sdata.message.addStringArg(vstring);
-					}
-					else if (results[k][0] == 'i') {
-						sdata.message.addIntArg(ofToInt(vstring));
-					}
-				}
-				playbackDataCached.push_back(sdata);
-			}
+	loadProgress = 0;
+	recordingLoader.load(afilePath);
+}
+
+//--------------------------------------------------------------
+void ofApp::listRecordings() {
+	string loadedPath = loadedRecordingIndex >= 0 ? recordingPaths[loadedRecordingIndex] : "";
+	recordingPaths.clear();
+	recordingNames.clear();
+	ofDirectory tdir;
+	tdir.allowExt("txt");
+	tdir.allowExt("mrec");
+	tdir.listDir("recordings");
+	for (int i = 0; i < tdir.size(); i++) {
+		recordingPaths.push_back(tdir.getPath(i));
+		recordingNames.push_back(tdir.getName(i));
+	}
+	recordingIndex.setMax(max(0, (int)recordingPaths.size() - 1));
+
+	// keep pointing at the loaded file when new ones sort in before it
+	for (int i = 0; i < recordingPaths.size(); i++) {
+		if (recordingPaths[i] == loadedPath) {
+			loadedRecordingIndex = i;
+			recordingIndex = i;
 		}
 	}
 }
 
 //--------------------------------------------------------------
-vector<string> ofApp::split(const string &s, char delim) {
-	stringstream ss(s);
-	string item;
-	vector<string> tokens;
-	while (getline(ss, item, delim)) {
-		tokens.push_back(item);
-	}
-	return tokens;
+void ofApp::reportHeapViolation() {
+	// the first one says which stage to look at, the gui counts the rest
+	if (bHeapViolationReported) return;
+	bHeapViolationReported = true;
+	ofLogWarning("ofApp") << "frame " << simFrame << " allocated after warming up:"
+		<< " pixels " << metrics.getLastAllocations(Metrics::STAGE_PIXELS)
+		<< ", drips " << metrics.getLastAllocations(Metrics::STAGE_DRIPS)
+		<< ", touching " << metrics.getLastAllocations(Metrics::STAGE_TOUCHING)
+		<< ", energies " << metrics.getLastAllocations(Metrics::STAGE_ENERGIES)
+		<< ", melt " << metrics.getLastAllocations(Metrics::STAGE_MELT)
+		<< ", led " << metrics.getLastAllocations(Metrics::STAGE_LED);
 }
 
 //--------------------------------------------------------------
@@ -480,19 +995,41 @@ void ofApp::keyPressed(int key) {
 	if (key == ' ') {
 		bRecording = !bRecording;
 	}
+	if (key == 'a') {
+		// archive the loaded recording next to the original
+		if (loadedRecordingIndex >= 0 && !recordingLoader.isLoading() && !RecordingCodec::isArchive(recordingPaths[loadedRecordingIndex])) {
+			string archivePath = ofFilePath::removeExt(recordingPaths[loadedRecordingIndex]) + ".mrec";
+			// only the copy happens here, the encoding runs on the archiver's thread
+			pipeline.lock();
+			recordingArchiver.archive(playbackDataCached, archivePath);
+			pipeline.unlock();
+		}
+	}
+	if (key == 'b') {
+		pipeline.lock();
+		flightRecorder.dump();
+		pipeline.unlock();
+	}
 	if (key == 's') {
 		gui.saveToFile("settings.xml");
 	}
 	if (key == 'l') {
 		gui.loadFromFile("settings.xml");
+		if (!flightRecorder.isDumping() && flightRecorder.getWindowSeconds() != flightMinutes * 60) {
+			pipeline.lock();
+			flightRecorder.setup(flightMinutes * 60);
+			pipeline.unlock();
+		}
 	}
 	if (key == 'f') {
+		pipeline.lock();
 		for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
 			for (auto section = it->second->sections.begin(); section != it->second->sections.end(); section++) {
 				section->second.percentLeft = 1.f;
 			}
 			it->second->restoring = true;
 		}
+		pipeline.unlock();
 	}
 }
 
@@ -500,24 +1037,16 @@ void ofApp::keyPressed(int key) {
 void ofApp::keyReleased(int key) {
 
 	if (key == 'r') {
-		pixels.clear();
-		for (int i = 0; i<numRows; i++) {
-			for (int j = 0; j<numCols; j++) {
-				Pixel p;
-				ofRectangle r;
-				r.width = ofGetWidth() / numRows - 2;
-				r.height = ofGetHeight() / numCols - 2;
-				r.x = ofGetWidth() / numRows*i + 1;
-				r.y = ofGetHeight() / numCols*j + 1;
-				p.rect = r;
-				pixels.push_back(p);
-			}
-		}
+		pipeline.lock();
+		buildPixels();
+		pipeline.unlock();
 	}
 	if (key == 'c') {
+		pipeline.lock();
 		for (auto it = skeletons.begin(); it != skeletons.end(); it++) {
 			it->second->color = (Skeleton::Color)(int)ofRandom(0, 4);
 		}
+		pipeline.unlock();
 	}
 }
 
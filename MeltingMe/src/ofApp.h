@@ -4,49 +4,25 @@
 #include "ofxGui.h"
 #include "ofxOsc.h"
 #include "Skeleton.h"
-
-class SkeletonData {
-public:
-	ofxOscMessage message;
-	float time = 0;
-};
-
-class Drip {
-public:
-	ofRectangle rect;
-	int a = 255;
-	float vel = 0;
-	ofColor color = ofColor(255);
-	void update(float speed);
-	void draw();
-	bool bRemove = false;
-};
-
-class Energy {
-public:
-	ofRectangle rect;
-	ofVec2f targetPoint;
-	int a = 0;
-	float vel = 0;
-	ofColor color = ofColor(255, 245, 0);
-	void update();
-	void draw();
-	bool bRemove = false;
-};
-
-class Pixel {
-public:
-	ofRectangle rect;
-	bool isLitUp = false;
-	bool isMelting = false;
-	bool isRestoring = false;
-	int a = 0;
-	ofColor color = ofColor(255, 255, 255);
-	void draw();
-	void update();
-	Drip createDrip(ofColor c);
-	float preScale = 0;
-};
+#include "Pixel.h"
+#include "SectionKernel.h"
+#include "GridKernels.h"
+#include "FramePipeline.h"
+#include "DripEmitter.h"
+#include "Energy.h"
+#include "FlightRecorder.h"
+#include "RecordingLoader.h"
+#include "RecordingArchiver.h"
+#include "RecordingCodec.h"
+#include "BatchedOscReceiver.h"
+#include "Shard.h"
+#include "Metrics.h"
+#include "LedOutput.h"
+#include "SensorFusion.h"
+#include "Replay.h"
+#include "DualRun.h"
+#include "OfflineRender.h"
+#include "HeapTracker.h"
 
 class ofApp : public ofBaseApp {
 public:
@@ -55,11 +31,30 @@ public:
 	void setup();
 	void update();
 	void draw();
-
-	void parseMessage(ofxOscMessage amsg);
+	void exit();
+
+	// one frame of ingest, melting, grid evaluation and drip physics
+	void simulate(float etimef, float dt);
+	void fillSnapshot(FrameSnapshot& asnapshot);
+	// copies the gui values simulate() uses, on the thread that owns the gui
+	void readSettings(FrameSettings& asettings);
+	void updateDrips(float dt);
+	void setMetricGauges();
+	void updateLedStats();
+	// render nodes step once per frame from the ingest node
+	void simulateShard(const ShardFrame& aframe);
+	// the part of the wall this node draws, all of it unless it renders a shard
+	ofRectangle getShardRegion();
+	// logs how the replay went and quits
+	void finishReplay();
+
+	void parseMessage(const ofxOscMessage& amsg, bool bLive = false);
+	bool getNextLiveMessage(ofxOscMessage& amsg);
 	void saveRecording();
 	void loadPlaybackData(string afilePath);
-	vector<string> split(const string &s, char delim);
+	void listRecordings();
+	// logs the stages that allocated in a frame that should not have
+	void reportHeapViolation();
 
 	void keyPressed(int key);
 	void keyReleased(int key);
@@ -72,8 +67,12 @@ public:
 	void windowResized(int w, int h);
 	void dragEvent(ofDragInfo dragInfo);
 	void gotMessage(ofMessage msg);
-	void updatePixels();
-	void detectTouching();
+	void buildPixels();
+	// index into pixels of grid cell (ax, ay), -1 if this node doesn't have it
+	int getPixelIndex(int ax, int ay);
+	void updatePixels(float dt);
+	void detectTouching(float dt);
+	void updateEnergies(float dt);
 
 	//    ofEasyCam cam;
 
@@ -81,13 +80,44 @@ public:
 	bool bHide;
 	ofParameter<bool> bDebug;
 	ofParameter<bool> bRecording;
+	ofParameter<float> flightMinutes;
 	ofParameter<bool> bUseRecordedData;
+	ofParameter<int> recordingIndex;
+	ofParameter<string> recordingName;
+	ofParameter<float> loadProgress;
 	ofParameter<bool> selfRestore;
+	ofParameter<bool> bPipelined;
 	ofParameter<int> dripCount;
+	ofParameter<bool> bBlockCoverage;
+	ofParameter<int> exactCells;
+	ofParameter<int> frameAllocations;
+	ofParameter<int> heapViolations;
+	ofParameter<bool> bBreakOnAlloc;
 	ofParameter<int> fps;
+	ofParameter<float> udpPacketsPerSecond;
+	ofParameter<float> udpKBytesPerSecond;
+	ofParameter<int> udpDrops;
+	ofParameter<int> udpTruncated;
+	ofParameter<int> shardFrameNum;
+	ofParameter<int> shardSkipped;
+	ofParameter<int> fusedBodies;
+	ofParameter<int> sensorDetections;
+	ofParameter<int> ledFrames;
+	ofParameter<int> ledIncomplete;
+	ofParameter<float> ledLatency;
+	ofParameter<bool> bValidate;
+	ofParameter<int> divergentFrames;
+	// false when this build's section kernels don't match ofPolyline, see setup()
+	bool bKernelsExact = true;
 	ofParameter<float> bodyWidth;
 	ofParameter<float> lastft;
 	ofParameter<float> dropSpeed;
+	ofParameter<float> dripRate;
+	ofParameter<int> dripBudget;
+	ofParameter<int> maxDrips;
+	ofParameter<float> energyRate;
+	ofParameter<int> energyCount;
+	ofParameter<float> energyTime;
 	ofParameter<float> meltingSpeedBase;
 	ofParameter<float> numRows = 120;
 	ofParameter<float> numCols = 90;
@@ -97,22 +127,109 @@ public:
 	ofParameter<int> offsetY;
 
 	ofxOscReceiver oscRX;
+	// used instead of oscRX with --udp-batched where recvmmsg is available
+	BatchedOscReceiver batchedRX;
+	BatchedOscConfig batchedOscConfig;
+	bool bUseBatchedUdp = false;
+	// replaces both when sensors.txt lists several Kinects
+	SensorFusion fusion;
+	bool bUseFusion = false;
+
+	// drives LED panels from the grid at venues that have a led-map.txt
+	LedOutput ledOutput;
+	bool bUseLedOutput = false;
+	// checks the LED frames on this host when led-map.txt targets 127.0.0.1
+	LedLoopbackCheck ledCheck;
+	bool bUseLedCheck = false;
+
+	// counters for remote monitoring, scraped from a local http page
+	Metrics metrics;
+	uint64_t lastPacketErrors = 0;
+	uint64_t lastFusionErrors = 0;
+
+	// plays a recording at a fixed timestep, see Replay.h
+	ReplayConfig replayConfig;
+	uint64_t replayFrame = 0;
+	bool bReplayFinished = false;
+	// the time simulate() is stepping, bodies are last seen at this rather than the clock
+	float simTime = 0;
+	uint64_t simFrame = 0;
+	// the frame Pixel::getCellRandom() draws for, the ingest node's on a render node
+	unsigned int cellFrame = 0;
+	// the stages after ingest must not allocate once bodies, the grid and
+	// the drip cap have held for this many frames
+	static const int WARM_UP_FRAMES = 60;
+	int steadyFrames = 0;
+	int lastNumSkeletons = -1;
+	int lastMaxDrips = -1;
+	bool bHeapViolationReported = false;
+
+	// runs the reference implementations next to the optimized ones
+	DualRun dualRun;
+	// writes the replayed frames to disk when --render is given
+	OfflineRenderer offlineRenderer;
+	bool bUseOfflineRender = false;
+
+	// simulates the next frame on a worker thread while draw() renders the last one
+	FramePipeline pipeline;
+	// what simulate() reads instead of the ofParameters, filled by readSettings()
+	FrameSettings settings;
 
 	string uniqueFilename = "";
 	float startRecordingTime = 0;
 
 	vector< SkeletonData > recordingData;
+	// keeps the last flightMinutes of live input for dumping after a glitch
+	FlightRecorder flightRecorder;
 	bool bUseLiveOsc = false;
 
-	vector<SkeletonData> playbackData;
 	vector<SkeletonData> playbackDataCached;
+	// the next message to play, all of them have played once it reaches the end
+	size_t playbackPosition = 0;
+	// a new recording came in, and the last batch of the loading one has
+	bool bRestartPlayback = false;
+	bool bPlaybackComplete = true;
+	RecordingLoader recordingLoader;
+	RecordingArchiver recordingArchiver;
+	vector<string> recordingPaths;
+	vector<string> recordingNames;
+	int loadedRecordingIndex = -1;
 	float playbackTimeStart = 0;
 	float touchingThreshold = 40;
 	float lastColorChangeTime = 0;
 
 	map< string, shared_ptr<Skeleton> > skeletons;
+	// the parts of the address parseMessage() is on
+	string addressParts[4];
+	// detectTouching() looks up each body's hands once
+	vector<Skeleton*> touchBodies;
+	vector< pair<ofVec3f, ofVec3f> > touchHands;
+
+	ShardConfig shardConfig;
+	ShardLink shardLink;
+	ShardFrame shardFrame;
+	// the grid is laid out over the ingest node's window on every node
+	float wallWidth = 0;
+	float wallHeight = 0;
 
 	vector<Pixel> pixels;
+	// the cells buildPixels() laid out, columns [start, end) of rows [0, end)
+	int pixelColumnStart = 0;
+	int pixelColumnEnd = 0;
+	int pixelRowEnd = 0;
+	// pixel rect centers, split by axis for SectionKernel
+	vector<float> pixelCentersX;
+	vector<float> pixelCentersY;
+	vector<unsigned char> pixelsInside;
+	// 8x8 and 2x2 blocks of the grid, so whole blocks can be settled at once
+	SectionKernel::BlockGrid pixelBlocks;
+	SectionKernel::BlockStats blockStats;
+	// picked by buildPixels() for the grid size
+	const GridKernels::Kernels* gridKernels = NULL;
 	vector<Drip> drips;
-	vector<Drip> energies;
+	DripEmitter dripEmitter;
+	// particles flowing from restoring pixels into the touching hands
+	EnergyPool energies;
+	vector<ofVec2f> energyTargets;
+	float energyMillis = 0;
 };
\ No newline at end of file